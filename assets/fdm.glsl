@@ -25,12 +25,16 @@ uniform int N;
 
 uniform float iLambda;
 uniform bool iIntegrationMode;
+uniform bool iPhasorMode;
 uniform bool iDecayMode;
 uniform bool iAmpladaFixa;
 uniform float iAmpladaMul;
 uniform bool iNormalitzarXarxa;
 uniform float iDecayExponent;
 uniform int iExperimentSelector;
+uniform bool iAccumulate;
+uniform int iSampleOffset;
+uniform int iSampleCount;
 
 vec3 hsv2rgb(vec3 c) {
     vec4 K = vec4(1.0, 2.0 / 3.0, 1.0 / 3.0, 3.0);
@@ -119,7 +123,7 @@ float test4(vec2 st, float t)
     }
     }
 
-    result /= count;
+    result /= float(count);
     return result;
 }
 
@@ -197,10 +201,75 @@ float executar(vec2 st, float tP) {
 	return result / L;
 }
 
+// MODE ACUMULACIÓ
+// Cada frame avalua iSampleCount mostres temporals noves, a partir de la iSampleOffset, i retorna la suma de
+// partial^2 sense dividir: l'app la suma amb blending additiu a un render target float i en mostra la mitjana
+// (fdmAccum.glsl). Els temps són la seqüència de van der Corput sobre un període, per tant les primeres
+// INTEGRATION_STEPS mostres són les de executar() i cada potència de 2 és una graella uniforme més fina
+float radicalInverse(int i) { 
+    float result = 0.0;
+    float scale = 0.5;
+    for(; i > 0; i /= 2) { 
+        if(i % 2 == 1) result += scale;
+        scale *= 0.5;
+    }
+    return result;
+}
+
+float executarAcumulat(vec2 st, float tP) { 
+	float result = 0.0;
+	float f = C / A_WAVE;
+	float w = f * 2.0 * M_PI;
+	float period = 2.0 * M_PI / w;
+	for(int i = 0; i < iSampleCount; i++) { 
+		float t = radicalInverse(iSampleOffset + i) * period;
+		float partial = experiment(st, t + tP);
+		result += partial * partial;
+	}
+	return result;
+}
+
+// MODE FASORIAL
+// Amplitud complexa de cada focus, la mitjana temporal de sin(kr - wt)^2 sumat es |sum a e^{ikr}|^2 / 2
+vec2 lightPhasor(vec2 st) { 
+    float l = length(vec3(st.x, st.y, iDistance));
+    float k = 2.0 * M_PI / LAMBDA;
+    float a = 1.0;
+    if(iDecayMode) a = lightValue(st);
+    return a * vec2(cos(l * k), sin(l * k));
+}
+
+vec2 netPhasor(vec2 st, float off, float separation) { 
+	vec2 result = vec2(0.0);
+  if(iAmpladaFixa)
+    separation = separation / float(N);
+	float offset = -float(N) * separation * 0.5 + off;
+	for(int i = 0; i < N; i++) { 
+		result += lightPhasor(st + vec2(0,offset));
+		offset += separation;
+	}
+	return result / float(N);
+}
+
+vec2 experimentPhasor(vec2 st) { 
+    if( iExperimentSelector == 0) return lightPhasor(st + vec2(0.0, -A_SEPARATION * 0.5)) * 0.5 + lightPhasor(st + vec2(0.0, A_SEPARATION * 0.5)) * 0.5;
+    if( iExperimentSelector == 1) return netPhasor(st, 0.0, iAmpladaMul * 10.0);
+    if( iExperimentSelector == 2) return netPhasor(st, 0.0, iAmpladaMul);
+	float o = 0.1e-3;
+	return netPhasor(st, -o/2.0, C_SEPARATION) * 0.5 + netPhasor(st, o/2.0, C_SEPARATION) * 0.5;
+}
+
+float executarFasor(vec2 st) { 
+    vec2 p = experimentPhasor(st);
+    return dot(p, p) * 0.5;
+}
+
 void main() { 
   vec2 st = realSt();
   float result;
-  if(iIntegrationMode) result = executar(st, iTime * TIME_ZOOM);
+  if(iIntegrationMode && iPhasorMode) result = executarFasor(st);
+  else if(iIntegrationMode && iAccumulate) result = executarAcumulat(st, iTime * TIME_ZOOM);
+  else if(iIntegrationMode) result = executar(st, iTime * TIME_ZOOM);
   else result = experiment(st, iTime * TIME_ZOOM);
 
   color = vec3(result);
@@ -0,0 +1,11 @@
+#version 300 es
+precision highp float;
+
+// Mitjana del mode acumulació de fdm.glsl: suma de partial^2 dividida per les mostres acumulades
+out vec3 color;
+uniform highp sampler2D iAccum;
+uniform float iSamples;
+
+void main() { 
+    color = vec3(texelFetch(iAccum, ivec2(gl_FragCoord.xy), 0).r / iSamples);
+}
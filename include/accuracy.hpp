@@ -0,0 +1,35 @@
+#pragma once
+#include <fdm.hpp>
+#include <string>
+
+/* REFERÈNCIA D'EXACTITUD
+ * Reimplementació en long double de light(), net(), experimentA-D i integrate() (i de la mitjana temporal exacta)
+ * amb la mateixa geometria que simulation.cpp, i comprovació de cada camí optimitzat contra aquesta referència en
+ * un conjunt de configuracions canòniques, amb un pressupost d'error per camí. */
+namespace fdm {
+
+// Referències amb els paràmetres p. index és el de experimentSelect()
+long double referenceLight(long double x, long double y, long double t, const SimulationParams& p);
+long double referenceNet(long double x, long double y, long double off, long double t, long double separation, const SimulationParams& p);
+long double referenceExperiment(int index, long double x, long double y, long double t, const SimulationParams& p);
+long double referenceIntegrate(int index, long double x, long double y, long double tP, const SimulationParams& p);
+
+// Mitjana temporal exacta de experiment(index)^2, el valor que aproximen el mode fasorial i el camp llunyà
+long double referencePhasor(int index, long double x, long double y, const SimulationParams& p);
+
+struct AccuracyCheck {
+  std::string path;      /* Camí comprovat */
+  std::string config;    /* Configuració canònica */
+  double      budget;    /* Error màxim, relatiu al màxim de la referència a la configuració */
+  double      error;     /* Error màxim trobat, amb la mateixa escala */
+  float       y;         /* Punt de la pantalla amb l'error més gran */
+  double      value;     /* Valor del camí en aquest punt */
+  double      reference; /* Valor de la referència en aquest punt */
+
+  bool pass() const { return error <= budget; }
+};
+
+// Comprova els camins indicats (noms de plotPathName() separats per comes, o "all") en points punts de la pantalla
+// per cada configuració, amb els paràmetres per defecte de SimulationParams i els de la configuració
+std::vector<AccuracyCheck> runAccuracyChecks(const std::string& paths = "all", int points = 400);
+} // namespace fdm
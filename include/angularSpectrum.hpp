@@ -0,0 +1,49 @@
+#pragma once
+#include <fdm.hpp>
+#include <fft.hpp>
+
+/* PROPAGACIÓ 2D PER ESPECTRE ANGULAR
+ * Propaga un camp complex mostrejat al pla de l'obertura (z = 0) fins a la pantalla (z = distance) amb
+ * FFT 2D -> H(fx, fy) = e^{ikz sqrt(1 - (lambda fx)^2 - (lambda fy)^2)} -> FFT inversa, i en treu la intensitat
+ * |U|^2 / 2, la mateixa mitjana temporal que executarFasor() a fdm.glsl. El cost és O(P log P) en els P píxels de
+ * la graella en lloc de O(P N INTEGRATION_STEPS) del shader, per tant admet obertures 2D denses.
+ *
+ * La graella es duplica amb zeros en cada direcció per evitar el solapament circular i H es limita en banda
+ * (Matsushima) per evitar aliasing a distàncies llargues. Tot i així el resultat només és vàlid mentre el feix
+ * difractat cap dins de la finestra; per la pantalla llunyana s'ha de fer servir el plot 1D. */
+namespace fdm {
+
+struct Field2D {
+  int                    width  = 0;
+  int                    height = 0;
+  float                  dx     = 1e-7; /* Separació entre mostres (m), igual en x i y */
+  std::vector<complex_t> data;          /* height files de width mostres, y = fila */
+};
+
+// Focus de experimentSources(func, p) al pla de l'obertura: columna central, fila més propera a cada focus.
+// Buit si func no és un experiment conegut
+Field2D experimentField(experiment_t func, int width, int height, float dx, const SimulationParams& p);
+
+/* Propagador amb els plans, la funció de transferència i els buffers de treball guardats entre crides: mentre no
+ * canviïn la mida, dx, lambda ni distance, cada frame només fa les quatre passades de FFT i les transposicions.
+ * Les files i les columnes es reparteixen entre els threads de workerPool(). */
+class AngularSpectrum {
+  public:
+  // Intensitat a distance de l'obertura, amb les mateixes dimensions que aperture
+  void propagate(const Field2D& aperture, double lambda, double distance, std::vector<float>& intensity);
+
+  private:
+  void prepare(int width, int height, float dx, double lambda, double distance);
+  void rows(std::vector<complex_t>& data, int rowSize, int rowCount, bool inverse);
+  void transpose(const std::vector<complex_t>& src, std::vector<complex_t>& dst, int srcWidth, int srcHeight);
+
+  int    width = 0, height = 0; /* Mida de la graella amb zero-padding */
+  float  dx       = 0.0;
+  double lambda   = 0.0;
+  double distance = 0.0;
+
+  std::vector<complex_t> field;      /* height x width */
+  std::vector<complex_t> transposed; /* width x height */
+  std::vector<complex_t> transfer;   /* H en l'ordre transposat */
+};
+} // namespace fdm
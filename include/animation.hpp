@@ -0,0 +1,35 @@
+#pragma once
+#include <raster.hpp>
+#include <cstdio>
+#include <functional>
+
+/* ANIMACIÓ DE LA IMATGE DE fdm.glsl
+ * Calcula la imatge de rasterize() per una seqüència de valors de iTime i l'envia en ordre a un sink que s'executa
+ * en un thread d'escriptura (OrderedWriter), com runSweep(): el càlcul de cada frame fa servir tot workerPool()
+ * mentre el frame anterior es converteix i s'escriu, i mai hi ha més de queueSize frames pendents d'escriure. Les imatges ja escrites es
+ * reaprofiten pels frames següents.
+ *
+ * Els frames es poden escriure en YUV4MPEG2 (escala de grisos de 8 bits, el llegeixen ffmpeg i mpv) o en float
+ * sense pèrdues amb una capçalera pròpia. Els dos formats s'escriuen frame a frame i serveixen per stdout. */
+namespace fdm {
+
+struct AnimationFrame {
+  int         index;
+  float       time; /* iTime del frame */
+  RasterImage image;
+};
+
+typedef std::function<void(const AnimationFrame&)> AnimationSink;
+
+// El frame i es calcula amb view.time + i * timeStep
+void runAnimation(const RasterView& view, const SimulationParams& p, int frames, float timeStep, const AnimationSink& sink, int queueSize = 4);
+
+// YUV4MPEG2 monocrom (Cmono): capçalera i, per cada frame, "FRAME" i clamp(valor * exposure, 0, 1) en 8 bits
+void writeY4mHeader(FILE* file, int width, int height, int fps);
+void writeY4mFrame(FILE* file, const RasterImage& image, float exposure = 1.0);
+
+// Float: "FDMA", versió, amplada, alçada i frames (int32). Després, per cada frame, iTime (float32) i els píxels
+// (float32) en el mateix ordre que RasterImage
+void writeRawHeader(FILE* file, int width, int height, int frames);
+void writeRawFrame(FILE* file, const AnimationFrame& frame);
+} // namespace fdm
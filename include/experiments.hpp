@@ -0,0 +1,169 @@
+#pragma once
+#include <fdm.hpp>
+#include <cmath>
+
+/* EXPERIMENTS ESPECIALITZATS
+ * Cada experiment és un tipus amb un mètode eval<Mode>() en lloc d'un experiment_t. Això permet instanciar el bucle
+ * d'integració per experiment i per combinació de flags (decay, amplada fixa, normalitzar), de manera que light()
+ * i net() queden inlined i el dispatch es fa un sol cop per plot en lloc d'una crida indirecta per mostra.
+ *
+ * Per afegir un experiment propi:
+ *
+ *   struct MyExperiment {
+ *     template <class M> static float eval(glm::vec2 st, float t, const KernelConstants& c) {
+ *       return lightKernel<M>(st, t, c);
+ *     }
+ *   };
+ *   registerExperiment(makeExperimentKernel<MyExperiment>("mine"));
+ *   plot(experimentFunction<MyExperiment>, params);
+ *
+ * plot() només fa servir el kernel registrat pels experiments sense experimentSources(): A-D tenen els focus
+ * descrits i van pels camins vectorials (integrateBatch(), integratePhasorBatch()...), i les seves entrades al
+ * registre serveixen per integrate() i per comparar. Els kernels registrats són mitjanes mostrejades, no tenen
+ * variant fasorial: en mode INTEGRATION_PHASOR el plot es calcula igualment mostrejat amb PlotResult::mode =
+ * INTEGRATION_SAMPLED.
+ */
+namespace fdm {
+
+// Paràmetres de la simulació que els kernels llegeixen un sol cop per plot
+struct KernelConstants {
+  float  k;          /* Nombre d'ona de p.uLambda */
+  float  w;          /* Freqüència angular de p.uLambda */
+  double decay;      /* pow(0.1, p.LIGHT_DECAY_EXPONENT) */
+  int    n;          /* p.NCOUNT */
+  float  ampladaMul; /* p.uAmpladaMul */
+  int    steps;      /* p.INTEGRATION_STEPS */
+  float  dt;         /* Pas de temps de integrate() */
+};
+
+KernelConstants kernelConstants(const SimulationParams& p);
+
+template <bool Decay, bool AmpladaFixa, bool Normalitzar>
+struct KernelMode {
+  static constexpr bool decay       = Decay;
+  static constexpr bool ampladaFixa = AmpladaFixa;
+  static constexpr bool normalitzar = Normalitzar;
+};
+
+// Índex de la combinació de flags de p a ExperimentKernel::integrate
+int kernelMode(const SimulationParams& p);
+
+// Mateix càlcul que light()
+template <class M>
+inline float lightKernel(glm::vec2 st, float t, const KernelConstants& c) {
+  float l     = glm::length(glm::vec3(st.x, st.y, 0));
+  float value = (std::sin(l * c.k - t * c.w) * 0.5 + 0.5);
+  if (M::decay) return value * float(c.decay / std::sqrt(st.x * st.x + st.y * st.y));
+  return value;
+}
+
+// Mateix càlcul que net()
+template <class M>
+inline float netKernel(glm::vec2 st, float off, float t, float separation, const KernelConstants& c) {
+  float result = 0.0;
+  if (M::ampladaFixa)
+    separation = separation / float(c.n);
+  float offset = -float(c.n) * separation * 0.5 + off;
+  for (int i = 0; i < c.n; i++) {
+    result += lightKernel<M>(st + glm::vec2(0, offset), t, c);
+    offset += separation;
+  }
+  if (M::normalitzar)
+    return result / float(c.n);
+  return result;
+}
+
+struct ExperimentA {
+  template <class M>
+  static float eval(glm::vec2 st, float t, const KernelConstants& c) {
+    return lightKernel<M>(st + glm::vec2(0.0, -A_SEPARATION * 0.5), t, c) * 0.5 + lightKernel<M>(st + glm::vec2(0.0, A_SEPARATION * 0.5), t, c) * 0.5;
+  }
+};
+
+struct ExperimentB {
+  template <class M>
+  static float eval(glm::vec2 st, float t, const KernelConstants& c) {
+    return netKernel<M>(st, 0.0, t, B_SEPARATION, c);
+  }
+};
+
+struct ExperimentC {
+  template <class M>
+  static float eval(glm::vec2 st, float t, const KernelConstants& c) {
+    return netKernel<M>(st, 0.0, t, c.ampladaMul, c);
+  }
+};
+
+struct ExperimentD {
+  template <class M>
+  static float eval(glm::vec2 st, float t, const KernelConstants& c) {
+    float o = 0.1e-3;
+    return netKernel<M>(st, -o / 2.0, t, C_SEPARATION, c) * 0.5 + netKernel<M>(st, o / 2.0, t, C_SEPARATION, c) * 0.5;
+  }
+};
+
+// Mateix càlcul que integrate() per count punts (x, y[i])
+template <class E, class M>
+void integrateKernel(float x, const float* y, int count, float tP, const SimulationParams& p, float* out) {
+  KernelConstants c = kernelConstants(p);
+  float           L = float(c.steps);
+  for (int i = 0; i < count; i++) {
+    glm::vec2 st(x, y[i]);
+    float     result = 0.0;
+    float     t      = 0.0;
+    for (int s = 0; s < c.steps; s++) {
+      float partial = E::template eval<M>(st, t + tP, c);
+      result += partial * partial;
+      t += c.dt;
+    }
+    out[i] = result / L;
+  }
+}
+
+typedef void (*integrate_kernel_t)(float x, const float* y, int count, float tP, const SimulationParams& p, float* out);
+
+struct ExperimentKernel {
+  const char*        name;
+  experiment_t       func;         /* Versió escalar, per plot(func) i integrate() */
+  integrate_kernel_t integrate[8]; /* Una instància per kernelMode() */
+};
+
+// experiment_t equivalent a E, amb el mode resolt a cada crida
+template <class E>
+float experimentFunction(glm::vec2 st, float t, const SimulationParams& p) {
+  KernelConstants c = kernelConstants(p);
+  switch (kernelMode(p)) {
+    case 0: return E::template eval<KernelMode<false, false, false>>(st, t, c);
+    case 1: return E::template eval<KernelMode<false, false, true>>(st, t, c);
+    case 2: return E::template eval<KernelMode<false, true, false>>(st, t, c);
+    case 3: return E::template eval<KernelMode<false, true, true>>(st, t, c);
+    case 4: return E::template eval<KernelMode<true, false, false>>(st, t, c);
+    case 5: return E::template eval<KernelMode<true, false, true>>(st, t, c);
+    case 6: return E::template eval<KernelMode<true, true, false>>(st, t, c);
+    default: return E::template eval<KernelMode<true, true, true>>(st, t, c);
+  }
+}
+
+template <class E>
+ExperimentKernel makeExperimentKernel(const char* name, experiment_t func = experimentFunction<E>) {
+  return {name,
+          func,
+          {
+            integrateKernel<E, KernelMode<false, false, false>>,
+            integrateKernel<E, KernelMode<false, false, true>>,
+            integrateKernel<E, KernelMode<false, true, false>>,
+            integrateKernel<E, KernelMode<false, true, true>>,
+            integrateKernel<E, KernelMode<true, false, false>>,
+            integrateKernel<E, KernelMode<true, false, true>>,
+            integrateKernel<E, KernelMode<true, true, false>>,
+            integrateKernel<E, KernelMode<true, true, true>>,
+          }};
+}
+
+// Registre d'experiments, inicialment amb A-D associats a experimentA-D. Es pot registrar des de qualsevol thread,
+// també amb plots en curs: el punter de findExperimentKernel() és vàlid fins al final del programa i
+// experimentRegistry() en torna una còpia
+std::vector<ExperimentKernel> experimentRegistry();
+void                          registerExperiment(const ExperimentKernel& kernel);
+const ExperimentKernel*       findExperimentKernel(experiment_t func);
+} // namespace fdm
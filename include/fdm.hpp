@@ -0,0 +1,204 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Separacions dels experiments del laboratori
+#define A_SEPARATION 0.01e-3
+#define B_SEPARATION 0.01e-3
+#define C_SEPARATION 0.001e-3
+
+/* SIMULACIÓ FDM (CPU)
+ * Aquest codi es el mateix que el de fdm.glsl, pero compilat directament en C++ per poder evaluar la gràfica en
+ * punts concrets i treure el plot */
+namespace fdm {
+
+enum IntegrationMode {
+  INTEGRATION_SAMPLED, /* Mitjana de INTEGRATION_STEPS mostres temporals, com integrate() */
+  INTEGRATION_PHASOR,  /* Mitjana temporal exacta a partir de la suma de fasors */
+};
+
+// Nivells de simd::sin/sincos que fan servir integrateBatch() i integratePhasorBatch() (simd.hpp)
+enum KernelPrecision {
+  PRECISION_FULL,   /* simd::PrecisionFull, ~1e-7 */
+  PRECISION_MEDIUM, /* simd::PrecisionMedium, ~1e-6 */
+  PRECISION_LOW,    /* simd::PrecisionLow, ~1e-4 */
+};
+
+const char* kernelPrecisionName(int precision);
+
+/* PARÀMETRES DE LA SIMULACIÓ
+ * Cada funció de la simulació rep els paràmetres com a const SimulationParams& p i no llegeix cap estat global, per
+ * tant diverses simulacions (la interfície, un sweep, un plot en segon pla) poden córrer alhora en threads
+ * diferents, cadascuna amb la seva còpia. El nombre de threads és del pool compartit (workerPool.hpp). */
+struct SimulationParams {
+  int   NCOUNT               = 5;                   /* Nombre de focus virtuals en xarxa de difracció */
+  int   INTEGRATION_STEPS    = 15;                  /* Nombre de pasos de integració per calcular la mitjana */
+  int   INTEGRATION_MODE     = INTEGRATION_SAMPLED; /* Mode de càlcul de la intensitat (IntegrationMode) */
+  bool  LIGHT_DECAY_ENABLED  = false;               /* Activar divisió per distancia */
+  bool  PHASE_REFERENCE      = true;                /* Fase dels kernels vectorials relativa al centre de la xarxa (precisa en float) */
+  int   KERNEL_PRECISION     = PRECISION_FULL;      /* Precisió del sin dels kernels vectorials (KernelPrecision) */
+  float LIGHT_DECAY_EXPONENT = 0.00002;             /* Correcció per exponent, per ajustar els valors a valors representables */
+  float plotting_distance    = 200e-3;              /* Distancia de la pantalla */
+  float plotting_resolution  = 4;                   /* Resolució del plot */
+  int   plotting_count       = 4000;                /* Cantitat de mostreig del plot */
+  int   plot_highpassWindow  = 10;                  /* Tamany de la finestra de cerca de màxims */
+  float plotting_fresnel     = 0.01;                /* Nombre de Fresnel màxim per fer servir Fraunhofer, 0 = mai */
+  float plotting_adaptive    = 0.0;                 /* Tolerància relativa del mostreig adaptatiu, 0 = uniforme */
+  int   plotting_geometry_mb = 64;                  /* Memòria màxima de la taula de distàncies del plot (MB), 0 = sense taula */
+  int   plotting_tree        = 4096;                /* Focus a partir dels quals el mode fasorial és jeràrquic, 0 = mai */
+  float plotting_tree_error  = 1e-4;                /* Error relatiu màxim de la interpolació de l'avaluació jeràrquica */
+
+  float uLambda           = 5000e-10;
+  float uAmpladaMul       = C_SEPARATION;
+  bool  uAmpladaFixa      = false;
+  bool  uNormalitzarXarxa = false;
+};
+
+// Últims paràmetres publicats, inicialment els per defecte. Qui edita els paràmetres (la interfície) modifica una
+// còpia pròpia i la publica sencera, i els threads que calculen en llegeixen una instantània consistent
+std::shared_ptr<const SimulationParams> publishedParams();
+void                                    publishParams(const SimulationParams& params);
+
+typedef float (*experiment_t)(glm::vec2 st, float t, const SimulationParams& p);
+
+float lightValue(glm::vec2 st, const SimulationParams& p);
+float light(glm::vec2 st, float t, const SimulationParams& p);
+float net(glm::vec2 st, float off, float t, float separation, const SimulationParams& p);
+float experimentA(glm::vec2 st, float t, const SimulationParams& p);
+float experimentB(glm::vec2 st, float t, const SimulationParams& p);
+float experimentC(glm::vec2 st, float t, const SimulationParams& p);
+float experimentD(glm::vec2 st, float t, const SimulationParams& p);
+float integrate(glm::vec2 st, float tP, experiment_t func, const SimulationParams& p);
+
+// Experiment del laboratori per índex (0 = A ... 3 = D), igual que iExperimentSelector a fdm.glsl
+experiment_t experimentSelect(int index);
+
+// Un experiment és una suma ponderada de focus puntuals desplaçats en Y
+struct ExperimentSource {
+  float offset;
+  float weight;
+};
+
+// Retorna els focus de l'experiment amb els paràmetres p, o buit si func no és un experiment conegut
+std::vector<ExperimentSource> experimentSources(experiment_t func, const SimulationParams& p);
+
+/* TAULA DE GEOMETRIA
+ * Les distàncies de cada punt de la pantalla a cada focus només depenen de x, dels punts i dels desplaçaments dels
+ * focus, no de lambda, del temps ni del decay. Amb una taula els kernels vectorials les llegeixen en lloc de fer
+ * l'arrel i la divisió per cada punt i focus, i en canviar lambda només es recalcula la trigonometria. Els valors
+ * són els mateixos que calculen els kernels, per tant el resultat no canvia. */
+struct GeometryTable {
+  int                 points  = 0; /* Punts, completats fins a múltiple de simd::vfloat::width repetint l'últim */
+  int                 sources = 0;
+  std::vector<double> r0;          /* Distància al centre de cada punt, en double per la fase de referència */
+  std::vector<float>  l;           /* Distància a cada focus, en blocs de width punts: [bloc][focus][punt] */
+  std::vector<float>  d;           /* l - r0 sense cancel·lació, amb la mateixa disposició */
+};
+
+// Memòria de la taula de count punts i sources focus
+size_t geometryTableBytes(int count, int sources);
+void   buildGeometryTable(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, GeometryTable& table);
+
+// Taula del thread pels mateixos arguments, que només es reconstrueix quan canvien. nullptr si ocupa més de maxBytes
+const GeometryTable* cachedGeometryTable(float x, const std::vector<float>& y, const std::vector<ExperimentSource>& sources, size_t maxBytes);
+
+// Equivalent vectorial de integrate() per count punts (x, y[i]) de la pantalla.
+// Amb PHASE_REFERENCE els kernels vectorials coincideixen amb una referència en double (mateixa geometria) amb un
+// error inferior a 2e-5 de la intensitat màxima per A-D, N <= 50 i pantalla a 0.2-1 m. Sense, l'error de la fase
+// en float arriba a ~0.3 de la intensitat màxima.
+// Amb geometry, y[0] és el punt first de la taula (first múltiple de simd::vfloat::width)
+void integrateBatch(float x, const float* y, int count, float tP, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                    const GeometryTable* geometry = nullptr, int first = 0);
+
+// Mitjana temporal tancada de integrate() per count punts (x, y[i]), O(N) per punt.
+// Cada focus aporta a * (0.5 + 0.5 sin(kr - wt)), per tant <E^2> = (sum a / 2)^2 + |sum a e^{ikr}|^2 / 8
+void integratePhasorBatch(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                          const GeometryTable* geometry = nullptr, int first = 0);
+
+// CAMP LLUNYÀ (FRAUNHOFER)
+// Els experiments A-D són grups de focus equiespaiats. Quan la pantalla és molt més lluny que l'amplada de cada
+// grup, r_j ~ r + s_j sin(theta) i la suma del grup és el factor de xarxa sin(n phi / 2) / sin(phi / 2), amb
+// phi = k d sin(theta). Això dóna la intensitat en O(grups) per punt, independentment de N.
+struct SourceGroup {
+  float center;  /* Desplaçament del centre del grup */
+  float spacing; /* Separació entre focus */
+  int   count;
+  float weight;
+};
+
+// Grups de l'experiment amb els paràmetres p, o buit si func no és un experiment conegut
+std::vector<SourceGroup> experimentGroups(experiment_t func, const SimulationParams& p);
+
+// a^2 / (lambda L) amb a la semiamplada del grup més ample i L = plotting_distance. L'error de fase de
+// l'aproximació és com a molt ~PI * F
+float fresnelNumber(const std::vector<SourceGroup>& groups, const SimulationParams& p);
+
+// Mitjana temporal (com integratePhasorBatch) amb l'aproximació de Fraunhofer dins de cada grup
+void integrateFarFieldBatch(float x, const float* y, int count, const std::vector<SourceGroup>& groups, const SimulationParams& p, float* out);
+
+/* AVALUACIÓ JERÀRQUICA
+ * Amb milers de focus (xarxes de moltes línies per mm) la suma directa és O(N) per punt. Els focus ordenats
+ * s'agrupen en clústers de 2^l focus consecutius i cada clúster guarda, mostrejat a la línia de la pantalla, el seu
+ * camp amb la fase del centre treta: G(y) = sum a_j e^{ik (r_j - R)}. Aquesta funció varia com a molt k h / x rad per
+ * metre (h la semiamplada del clúster), per tant unes poques mostres per període la interpolen amb l'error que es
+ * demani. Les taules d'un nivell surten directament dels focus o de les del nivell anterior (interpolades i girades
+ * pel canvi de centre), i els punts sumen les taules d'un sol nivell. El nivell i el mètode surten d'un model de cost,
+ * i si cap és més barat que la suma directa es fa servir integratePhasorBatch(). */
+
+// Mitjana temporal (com integratePhasorBatch) amb error relatiu a sum |a| inferior a p.plotting_tree_error. Les taules
+// cobreixen [min y, max y], per tant convé cridar-la amb tots els punts alhora
+void integrateTreeBatch(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out);
+
+// Les taules de integrateTreeBatch() per avaluar-les diverses vegades amb els mateixos focus (mostreig adaptatiu).
+// Cobreixen [yMin, yMax], i count és el nombre de punts que s'hi avaluaran en total, pel model de cost. Retorna
+// nullptr si la suma directa (integratePhasorBatch()) és més barata
+struct SourceTree;
+std::shared_ptr<const SourceTree> buildSourceTree(float x, double yMin, double yMax, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p);
+void                              evaluateSourceTree(const SourceTree& tree, const float* y, int count, float* out);
+
+// Funcions per trobar els valors del plot
+enum PlotPath {
+  PLOT_PATH_SCALAR,   /* integrate() amb experiment_t */
+  PLOT_PATH_KERNEL,   /* Kernel especialitzat del registre d'experiments */
+  PLOT_PATH_SAMPLED,  /* integrateBatch() */
+  PLOT_PATH_PHASOR,   /* integratePhasorBatch() */
+  PLOT_PATH_FARFIELD, /* integrateFarFieldBatch() */
+  PLOT_PATH_FFT,      /* apertureFarField() (aperture.hpp) */
+  PLOT_PATH_TREE,     /* integrateTreeBatch() */
+};
+
+const char* plotPathName(int path);
+
+struct PlotResult {
+  std::vector<float> y;
+  std::vector<float> x;
+  int                path    = PLOT_PATH_SCALAR; /* Camí que ha calculat y */
+  float              fresnel = 0.0;              /* Nombre de Fresnel de l'experiment, si té grups */
+  int                mode    = INTEGRATION_SAMPLED; /* Mode que ha calculat y: sense experimentSources() sempre és el mostrejat */
+};
+
+// Amb plotting_adaptive > 0 el resultat és un subconjunt ordenat dels punts de la graella uniforme, més dens on la
+// corba s'allunya de la interpolació lineal, i plot_highpassWindow compta punts d'aquest subconjunt
+PlotResult       plot(experiment_t func, const SimulationParams& p);
+std::vector<int> findLocalMaximumValues(std::vector<float>& data, const SimulationParams& p);
+
+// Plot amb els seus màxims locals (maximum, a xMax/yMax) i els màxims d'aquests màxims (maximum2)
+struct PlotAnalysis {
+  PlotResult         data;
+  std::vector<int>   maximum;
+  std::vector<float> xMax;
+  std::vector<float> yMax;
+  std::vector<int>   maximum2;
+};
+
+PlotAnalysis analyzePlot(experiment_t func, const SimulationParams& p);
+PlotAnalysis analyzePlot(PlotResult data, const SimulationParams& p);
+
+// Hash de tots els paràmetres que afecten el resultat de plot(func, p) i dels seus màxims
+uint64_t plotKey(experiment_t func, const SimulationParams& p);
+
+// plot() + findLocalMaximumValues(), retorna l'últim resultat del thread si plotKey(func, p) no ha canviat
+const PlotAnalysis& cachedPlotAnalysis(experiment_t func, const SimulationParams& p);
+} // namespace fdm
@@ -0,0 +1,28 @@
+#pragma once
+#include <fdm.hpp>
+#include <accuracy.hpp>
+#include <animation.hpp>
+#include <angularSpectrum.hpp>
+#include <aperture.hpp>
+#include <experiments.hpp>
+#include <peaks.hpp>
+#include <plotWorker.hpp>
+#include <raster.hpp>
+#include <spectrum.hpp>
+#include <sweep.hpp>
+#include <workerPool.hpp>
+
+/* NEXTVIDEOFDM
+ * Capçalera pública de la biblioteca de simulació: kernels (fdm.hpp, experiments.hpp), plot i camp llunyà,
+ * detecció de màxims (peaks.hpp), sweeps, obertures, espectre angular, la imatge de fdm.glsl a la CPU (raster.hpp)
+ * i la seva animació (animation.hpp), el mode espectral (spectrum.hpp) i la referència d'exactitud. Només depèn de
+ * glm, dels threads del sistema i de stb_image_write (només capçalera), sense GL, GLFW ni GLEW, per poder-la
+ * incrustar en serveis sense pantalla:
+ *
+ *   add_subdirectory(NextVideo)    # amb -DNEXTVIDEO_GL=OFF no es configuren GLFW ni GLEW
+ *   target_link_libraries(servei NextVideoFDM)
+ *
+ *   fdm::SimulationParams p;
+ *   p.NCOUNT = 50;
+ *   fdm::PlotAnalysis plot = fdm::analyzePlot(fdm::experimentC, p);
+ */
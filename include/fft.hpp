@@ -0,0 +1,29 @@
+#pragma once
+#include <complex>
+#include <vector>
+
+/* FFT
+ * Radix-2 iteratiu en double, sense dependències externes. Els plans (taula de bit-reversal i twiddles) només
+ * depenen de la mida i es guarden en una caché global, de manera que les transformades repetides de la mateixa
+ * mida (plots, sweeps, propagació 2D) no els tornen a calcular. */
+namespace fdm {
+
+typedef std::complex<double> complex_t;
+
+struct FftPlan {
+  int                    size;
+  std::vector<int>       reverse;  /* Permutació de bit-reversal */
+  std::vector<complex_t> twiddles;  /* e^{-2 PI i j / size}, j < size / 2 */
+};
+
+// Potència de 2 més petita >= n
+int fftSize(int n);
+
+// Pla per a size (potència de 2). La referència és vàlida durant tota l'execució i es pot fer servir des de
+// qualsevol thread
+const FftPlan& fftPlan(int size);
+
+// Transformada in-place de plan.size elements: X_j = sum x_m e^{-2 PI i j m / size}.
+// La inversa fa servir e^{+...} i no divideix per size
+void fft(const FftPlan& plan, complex_t* data, bool inverse = false);
+} // namespace fdm
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+/* ESCRIPTURA EN ORDRE
+ * Un thread d'escriptura que rep resultats indexats 0, 1, 2... des de qualsevol thread i els passa al sink en ordre
+ * d'índex, de manera que el càlcul i l'escriptura se solapen. Només es pot començar l'índex i quan i < escrits +
+ * window: amb el que s'està escrivint, mai hi ha més de window + 1 resultats en memòria. L'índex més baix pendent
+ * sempre es pot començar, per tant els threads que esperen a wait() no es bloquegen entre ells si els índexs
+ * s'agafen en ordre creixent (com els blocs de WorkerPool::parallelFor()). */
+namespace fdm {
+
+template <class T>
+class OrderedWriter {
+  public:
+  typedef std::function<void(T&)> Sink;
+
+  OrderedWriter(const Sink& sink, int window) : sink(sink), window(std::max(window, 1)), writer(&OrderedWriter::writeLoop, this) {}
+  ~OrderedWriter() { finish(); }
+
+  OrderedWriter(const OrderedWriter&)            = delete;
+  OrderedWriter& operator=(const OrderedWriter&) = delete;
+
+  // Espera fins que l'índex cap a la finestra
+  void wait(int index) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return index < written + window; });
+  }
+
+  void push(int index, T value) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return index < written + window; });
+    pending.emplace(index, std::move(value));
+    lock.unlock();
+    changed.notify_all();
+  }
+
+  // Escriu els resultats pendents i espera el thread d'escriptura. Tots els índexs anteriors han d'estar a push()
+  void finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      finished = true;
+    }
+    changed.notify_all();
+    if (writer.joinable()) writer.join();
+  }
+
+  private:
+  void writeLoop() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&] { return finished || pending.count(written); });
+      typename std::map<int, T>::iterator next = pending.find(written);
+      if (next == pending.end()) return;
+
+      T value = std::move(next->second);
+      pending.erase(next);
+      written++;
+      lock.unlock();
+      changed.notify_all();
+
+      sink(value);
+    }
+  }
+
+  Sink                    sink;
+  int                     window;
+  std::map<int, T>        pending;
+  int                     written  = 0;
+  bool                    finished = false;
+  std::mutex              mutex;
+  std::condition_variable changed;
+  std::thread             writer; /* L'últim: el thread arrenca quan la resta ja està construïda */
+};
+} // namespace fdm
@@ -0,0 +1,37 @@
+#pragma once
+#include <vector>
+
+/* DETECTOR DE MÀXIMS LOCALS EN STREAMING
+ * Mateix criteri que findLocalMaximumValues(): la mostra i és un màxim si cap mostra de la finestra
+ * [i - window, i + window) és més gran, amb window <= i i i + window + 1 < n. Una cua monotònica guarda els
+ * candidats a màxim de la finestra, de manera que cada mostra entra i surt una sola vegada (O(n) en total, en lloc
+ * de O(n window)), i les dades poden arribar en blocs de qualsevol mida. */
+namespace fdm {
+
+class PeakDetector {
+  public:
+  // window < 0 no troba cap màxim
+  explicit PeakDetector(int window);
+
+  // Afegeix count mostres a continuació de les anteriors i escriu a peaks (índexs globals, en ordre) els màxims
+  // que ja es poden decidir. Cada índex es decideix window + 2 mostres després d'haver-lo rebut
+  void push(const float* data, int count, std::vector<int>& peaks);
+  void push(float value, std::vector<int>& peaks) { push(&value, 1, peaks); }
+
+  // Torna a començar des de l'índex 0
+  void reset();
+
+  private:
+  int window;
+  int count = 0; /* Mostres rebudes */
+  int mask;
+
+  std::vector<float> history;    /* Últimes mostres, per índex & mask */
+  std::vector<int>   queueIndex; /* Cua circular d'índexs amb valors no creixents, de head a tail */
+  std::vector<float> queueValue;
+  unsigned           head = 0;
+  unsigned           tail = 0;
+  int                pending[2];
+  int                pendingCount = 0;
+};
+} // namespace fdm
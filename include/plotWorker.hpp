@@ -0,0 +1,46 @@
+#pragma once
+#include <fdm.hpp>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/* PLOT EN SEGON PLA
+ * Calcula analyzePlot() en un thread propi amb una instantània dels paràmetres, de manera que la interfície no
+ * s'atura mentre es recalcula un plot gran. Només es calcula l'última petició: les que arriben durant un càlcul
+ * substitueixen la pendent, i mentrestant result() retorna l'últim plot acabat. */
+namespace fdm {
+
+class PlotWorker {
+  public:
+  PlotWorker();
+  ~PlotWorker();
+
+  PlotWorker(const PlotWorker&)            = delete;
+  PlotWorker& operator=(const PlotWorker&) = delete;
+
+  // Demana analyzePlot(func, *params) si plotKey() és diferent de l'última petició
+  void request(experiment_t func, std::shared_ptr<const SimulationParams> params);
+
+  // Últim plot acabat, nullptr fins que n'hi ha un
+  std::shared_ptr<const PlotAnalysis> result() const;
+
+  // Cert mentre hi ha una petició pendent o en curs
+  bool busy() const;
+
+  private:
+  void loop();
+
+  mutable std::mutex      mutex;
+  std::condition_variable wake;
+
+  experiment_t                            func = nullptr;
+  std::shared_ptr<const SimulationParams> params; /* Petició pendent */
+  uint64_t                                requested = 0;
+  bool                                    pending   = false;
+  bool                                    running   = false;
+  bool                                    exiting   = false;
+  std::shared_ptr<const PlotAnalysis>     latest;
+  std::thread                             thread;
+};
+} // namespace fdm
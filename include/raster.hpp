@@ -0,0 +1,113 @@
+#pragma once
+#include <fdm.hpp>
+#include <spectrum.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* RASTERITZADOR CPU DE fdm.glsl
+ * Calcula el main() del shader per cada píxel sense context GL: realSt(), iExperimentSelector, mode instantani,
+ * integració mostrejada (executar) o fasorial (executarFasor) i decay. Serveix per renderitzar imatges sense
+ * pantalla i com a referència del shader.
+ *
+ * El camp del shader no és el mateix que el de fdm.hpp: iDistance és la coordenada z dels focus, al mode integrat
+ * light() no suma 0.5, net() sempre divideix per N i l'experiment B fa servir iAmpladaMul * 10. Per això els
+ * focus surten de shaderSources() i no d'experimentSources().
+ *
+ * La imatge es divideix en tessel·les de RASTER_TILE x RASTER_TILE píxels que es reparteixen entre els threads de
+ * workerPool(), i dins de cada fila de la tessel·la els píxels s'avaluen de simd::vfloat::width en
+ * simd::vfloat::width amb el sin de p.KERNEL_PRECISION. Amb p.PHASE_REFERENCE la fase es calcula relativa a la
+ * distància al centre (com integrateBatch()), per tant és més precisa que la del shader en float. */
+namespace fdm {
+
+// Uniforms de fdm.glsl que no són a SimulationParams. El mode fasorial (iPhasorMode) és p.INTEGRATION_MODE
+struct RasterView {
+  int   width       = 1920;
+  int   height      = 1080;
+  float zoom        = 1.0;   /* iZoom */
+  float time        = 0.0;   /* iTime */
+  float distance    = 0.0;   /* iDistance */
+  int   experiment  = 0;     /* iExperimentSelector */
+  bool  integration = false; /* iIntegrationMode */
+  int   steps       = 4;     /* INTEGRATION_STEPS de fdm.glsl (fix al shader) */
+
+  bool operator==(const RasterView& o) const {
+    return width == o.width && height == o.height && zoom == o.zoom && time == o.time && distance == o.distance && experiment == o.experiment &&
+           integration == o.integration && steps == o.steps;
+  }
+  bool operator!=(const RasterView& o) const { return !(*this == o); }
+};
+
+struct RasterImage {
+  int                width    = 0;
+  int                height   = 0;
+  int                channels = 1; /* 3 (RGB) a rasterizeSpectral() */
+  std::vector<float> data;         /* height files de width píxels de channels valors, la fila 0 és la de dalt (gl_FragCoord.y = height - 0.5) */
+};
+
+// Focus de experiment() a fdm.glsl per l'índex iExperimentSelector
+std::vector<ExperimentSource> shaderSources(int experiment, const SimulationParams& p);
+
+// Valor de color del shader (abans de limitar-lo a [0, 1]) per cada píxel de view
+void rasterize(const RasterView& view, const SimulationParams& p, RasterImage& image);
+
+// Mode espectral (spectrum.hpp): mitjana temporal de executarFasor() a cada longitud d'ona de table, en RGB. No
+// depèn de iTime, iIntegrationMode ni del mode d'integració, i la fase és sempre relativa al centre
+void rasterizeSpectral(const RasterView& view, const SimulationParams& p, const SpectralTable& table, RasterImage& image);
+
+// clamp(valor * exposure, 0, 1) en 8 bits per cada valor, pixels ha de tenir lloc per image.data.size() bytes
+void imageToBytes(const RasterImage& image, float exposure, uint8_t* pixels);
+
+// PNG de 8 bits (escala de grisos o RGB segons channels) amb clamp(valor * exposure, 0, 1), com el framebuffer del shader amb
+// exposure = 1. Retorna false si no es pot escriure
+bool writePng(const char* path, const RasterImage& image, float exposure = 1.0);
+
+#define PROGRESSIVE_COARSE 4 /* Pas de la primera passada de ProgressiveRaster, 1/16 dels píxels */
+
+struct RasterFrame;
+
+/* RASTER PROGRESSIU
+ * La mateixa imatge que rasterize(), calculada de gruixut a fi perquè la interfície tingui una imatge en pocs ms
+ * en lloc d'esperar tots els píxels. La primera passada calcula un píxel de cada PROGRESSIVE_COARSE en x i en y, i
+ * cada passada següent divideix el pas per 2 i només calcula els píxels que no són de la graella anterior. La resta
+ * de píxels s'interpolen bilinealment de la graella de la passada en curs a mesura que s'acaben les files.
+ *
+ * No té thread propi: el bucle de la interfície crida step() cada frame amb el temps que hi pot dedicar, i una
+ * petició amb paràmetres diferents descarta la imatge en curs. Les files de cada lot es reparteixen entre els
+ * threads de workerPool(). */
+class ProgressiveRaster {
+  public:
+  ProgressiveRaster();
+  ~ProgressiveRaster();
+
+  ProgressiveRaster(const ProgressiveRaster&)            = delete;
+  ProgressiveRaster& operator=(const ProgressiveRaster&) = delete;
+
+  // Comença de nou si view o plotKey() han canviat. Mentre la mida no canviï, image() conserva l'anterior fins
+  // que la sobreescriu la primera passada
+  void request(const RasterView& view, const SimulationParams& p);
+
+  // Calcula lots d'una fila per thread fins que passen budgetMs, retorna cert si image() ha canviat. Es pot passar
+  // de budgetMs com a molt un lot
+  bool step(double budgetMs);
+
+  // Pas de la passada en curs (PROGRESSIVE_COARSE, ..., 1), 0 quan la imatge està acabada
+  inline int  stride() const { return current; }
+  inline bool done() const { return current == 0; }
+
+  // Píxels calculats i interpolats, en el mateix ordre que rasterize()
+  inline const RasterImage& image() const { return result; }
+
+  private:
+  void beginPass();
+
+  std::unique_ptr<RasterFrame> frame;
+  RasterView                   view;
+  uint64_t                     key   = 0;
+  bool                         valid = false;
+  RasterImage                  result;
+  int                          current = 0; /* Pas de la passada en curs */
+  std::vector<int>             rows;        /* Files de la passada en curs */
+  int                          next = 0;    /* Primera fila de rows que falta */
+};
+} // namespace fdm
@@ -0,0 +1,291 @@
+#pragma once
+#include <cmath>
+
+// Selecció del backend vectorial en temps de compilació (veure FDM_NATIVE al CMakeLists.txt)
+#if defined(__AVX2__) && defined(__FMA__)
+#  include <immintrin.h>
+#  define SIMD_AVX2
+#elif defined(__SSE2__)
+#  include <emmintrin.h>
+#  define SIMD_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#  include <arm_neon.h>
+#  define SIMD_NEON
+#else
+#  define SIMD_SCALAR
+#endif
+
+/* Tipus vectorial mínim per als kernels de la simulació.
+ * Cada backend implementa les mateixes operacions sobre simd::vfloat i les funcions genèriques
+ * (sin, ...) s'escriuen una sola vegada a sobre. */
+namespace simd {
+
+#if defined(SIMD_AVX2)
+constexpr const char* backendName = "avx2";
+
+struct vfloat {
+  static constexpr int width = 8;
+  __m256               v;
+
+  vfloat() = default;
+  vfloat(__m256 _v) : v(_v) {}
+  vfloat(float f) : v(_mm256_set1_ps(f)) {}
+
+  static inline vfloat load(const float* p) { return _mm256_loadu_ps(p); }
+  inline void          store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm256_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm256_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm256_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm256_div_ps(a.v, b.v); }
+inline vfloat fma(vfloat a, vfloat b, vfloat c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline vfloat sqrt(vfloat a) { return _mm256_sqrt_ps(a.v); }
+inline vfloat round(vfloat a) { return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+inline vfloat floor(vfloat a) { return _mm256_floor_ps(a.v); }
+// Retorna a on c != 0 i b a la resta
+inline vfloat select(vfloat c, vfloat a, vfloat b) {
+  return _mm256_blendv_ps(b.v, a.v, _mm256_cmp_ps(c.v, _mm256_setzero_ps(), _CMP_NEQ_UQ));
+}
+
+#elif defined(SIMD_SSE2)
+constexpr const char* backendName = "sse2";
+
+struct vfloat {
+  static constexpr int width = 4;
+  __m128               v;
+
+  vfloat() = default;
+  vfloat(__m128 _v) : v(_v) {}
+  vfloat(float f) : v(_mm_set1_ps(f)) {}
+
+  static inline vfloat load(const float* p) { return _mm_loadu_ps(p); }
+  inline void          store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return _mm_add_ps(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return _mm_sub_ps(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return _mm_mul_ps(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return _mm_div_ps(a.v, b.v); }
+inline vfloat fma(vfloat a, vfloat b, vfloat c) { return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v); }
+inline vfloat sqrt(vfloat a) { return _mm_sqrt_ps(a.v); }
+inline vfloat round(vfloat a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+inline vfloat floor(vfloat a) {
+  __m128 t = _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+}
+inline vfloat select(vfloat c, vfloat a, vfloat b) {
+  __m128 mask = _mm_cmpneq_ps(c.v, _mm_setzero_ps());
+  return _mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v));
+}
+
+#elif defined(SIMD_NEON)
+constexpr const char* backendName = "neon";
+
+struct vfloat {
+  static constexpr int width = 4;
+  float32x4_t          v;
+
+  vfloat() = default;
+  vfloat(float32x4_t _v) : v(_v) {}
+  vfloat(float f) : v(vdupq_n_f32(f)) {}
+
+  static inline vfloat load(const float* p) { return vld1q_f32(p); }
+  inline void          store(float* p) const { vst1q_f32(p, v); }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return vaddq_f32(a.v, b.v); }
+inline vfloat operator-(vfloat a, vfloat b) { return vsubq_f32(a.v, b.v); }
+inline vfloat operator*(vfloat a, vfloat b) { return vmulq_f32(a.v, b.v); }
+inline vfloat operator/(vfloat a, vfloat b) { return vdivq_f32(a.v, b.v); }
+inline vfloat fma(vfloat a, vfloat b, vfloat c) { return vfmaq_f32(c.v, a.v, b.v); }
+inline vfloat sqrt(vfloat a) { return vsqrtq_f32(a.v); }
+inline vfloat round(vfloat a) { return vrndnq_f32(a.v); }
+inline vfloat floor(vfloat a) { return vrndmq_f32(a.v); }
+inline vfloat select(vfloat c, vfloat a, vfloat b) {
+  return vbslq_f32(vmvnq_u32(vceqq_f32(c.v, vdupq_n_f32(0.0f))), a.v, b.v);
+}
+
+#else
+constexpr const char* backendName = "scalar";
+
+struct vfloat {
+  static constexpr int width = 1;
+  float                v;
+
+  vfloat() = default;
+  vfloat(float f) : v(f) {}
+
+  static inline vfloat load(const float* p) { return *p; }
+  inline void          store(float* p) const { *p = v; }
+};
+
+inline vfloat operator+(vfloat a, vfloat b) { return a.v + b.v; }
+inline vfloat operator-(vfloat a, vfloat b) { return a.v - b.v; }
+inline vfloat operator*(vfloat a, vfloat b) { return a.v * b.v; }
+inline vfloat operator/(vfloat a, vfloat b) { return a.v / b.v; }
+inline vfloat fma(vfloat a, vfloat b, vfloat c) { return a.v * b.v + c.v; }
+inline vfloat sqrt(vfloat a) { return std::sqrt(a.v); }
+inline vfloat round(vfloat a) { return std::nearbyint(a.v); }
+inline vfloat floor(vfloat a) { return std::floor(a.v); }
+inline vfloat select(vfloat c, vfloat a, vfloat b) { return c.v != 0.0f ? a : b; }
+#endif
+
+// Reducció x = q * PI/2 + r amb |r| <= PI/4.
+// Les fases de la simulació arriben a ~1e7 rad, per tant la reducció ha de ser exacta en aquest rang:
+// amb FMA s'utilitza Cody-Waite en tres parts, i sense FMA es fa la resta en double.
+#if defined(SIMD_AVX2) || defined(SIMD_NEON)
+inline vfloat reduceHalfPi(vfloat x, vfloat& q) {
+  q        = round(x * 0.636619746685028076171875f);
+  vfloat r = fma(q, -1.57079637050628662109375f, x);
+  r        = fma(q, 4.37113882867379300296306610107421875e-8f, r);
+  return fma(q, 1.7151245100058819e-15f, r);
+}
+#elif defined(SIMD_SSE2)
+inline vfloat reduceHalfPi(vfloat x, vfloat& q) {
+  const __m128d pio2 = _mm_set1_pd(M_PI / 2.0);
+  q                  = round(x * 0.636619746685028076171875f);
+  __m128d rl         = _mm_sub_pd(_mm_cvtps_pd(x.v), _mm_mul_pd(_mm_cvtps_pd(q.v), pio2));
+  __m128d rh         = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(x.v, x.v)), _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(q.v, q.v)), pio2));
+  return _mm_movelh_ps(_mm_cvtpd_ps(rl), _mm_cvtpd_ps(rh));
+}
+#else
+inline vfloat reduceHalfPi(vfloat x, vfloat& q) {
+  q = round(x * 0.636619746685028076171875f);
+  return float(double(x.v) - double(q.v) * (M_PI / 2.0));
+}
+#endif
+
+// Reducció x = q * 2PI + r amb |r| <= PI, amb les mateixes constants que reduceHalfPi() multiplicades per 4
+#if defined(SIMD_AVX2) || defined(SIMD_NEON)
+inline vfloat reduceTwoPi(vfloat x) {
+  vfloat q = round(x * 0.15915493667125701904296875f);
+  vfloat r = fma(q, -6.283185482025146484375f, x);
+  r        = fma(q, 1.7484555314695172011852264404296875e-7f, r);
+  return fma(q, 6.8604980400235276e-15f, r);
+}
+#elif defined(SIMD_SSE2)
+inline vfloat reduceTwoPi(vfloat x) {
+  const __m128d twoPi = _mm_set1_pd(2.0 * M_PI);
+  vfloat        q     = round(x * 0.15915493667125701904296875f);
+  __m128d       rl    = _mm_sub_pd(_mm_cvtps_pd(x.v), _mm_mul_pd(_mm_cvtps_pd(q.v), twoPi));
+  __m128d       rh    = _mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(x.v, x.v)), _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(q.v, q.v)), twoPi));
+  return _mm_movelh_ps(_mm_cvtpd_ps(rl), _mm_cvtpd_ps(rh));
+}
+#else
+inline vfloat reduceTwoPi(vfloat x) {
+  vfloat q = round(x * 0.15915493667125701904296875f);
+  return float(double(x.v) - double(q.v) * (2.0 * M_PI));
+}
+#endif
+
+// Polinomis de Cephes a [-PI/4, PI/4], amb z = r * r
+inline vfloat sinPoly(vfloat r, vfloat z) {
+  return fma(fma(fma(-1.9515295891e-4f, z, 8.3321608736e-3f), z, -1.6666654611e-1f), z * r, r);
+}
+inline vfloat cosPoly(vfloat z) {
+  return fma(fma(fma(2.443315711809948e-5f, z, -1.388731625493765e-3f), z, 4.166664568298827e-2f), z * z, fma(z, -0.5f, 1.0f));
+}
+
+/* NIVELLS DE PRECISIÓ
+ * Polítiques amb sin() i sincos() que els kernels reben com a paràmetre de plantilla. Error absolut màxim mesurat
+ * per fdm_cli --check (accuracy.cpp) per |x| <= 1e5 rad. Per sobre de ~1e6 rad la reducció en float domina l'error:
+ *  - PrecisionFull:   Cephes a [-PI/4, PI/4] amb selecció de quadrant, ~1e-7.
+ *  - PrecisionMedium: minimax de grau 11/12 a [-PI, PI], sense quadrants, ~1e-6.
+ *  - PrecisionLow:    minimax de grau 9/8 a [-PI, PI], ~1e-4, suficient per la vista interactiva. */
+struct PrecisionFull {
+  static constexpr const char* name = "full";
+
+  static inline vfloat sin(vfloat x) {
+    vfloat q;
+    vfloat r = reduceHalfPi(x, q);
+    vfloat z = r * r;
+    vfloat s = sinPoly(r, z);
+    vfloat c = cosPoly(z);
+
+    // Quadrant: q mod 2 escull cos, (q / 2) mod 2 canvia el signe
+    vfloat h   = floor(q * 0.5f);
+    vfloat odd = q - h * 2.0f;
+    vfloat neg = h - floor(h * 0.5f) * 2.0f;
+    return select(odd, c, s) * fma(neg, -2.0f, 1.0f);
+  }
+
+  static inline void sincos(vfloat x, vfloat& sinx, vfloat& cosx) {
+    vfloat q;
+    vfloat r = reduceHalfPi(x, q);
+    vfloat z = r * r;
+    vfloat s = sinPoly(r, z);
+    vfloat c = cosPoly(z);
+
+    // sin canvia de signe als quadrants 2 i 3, cos als quadrants 1 i 2
+    vfloat h   = floor(q * 0.5f);
+    vfloat odd = q - h * 2.0f;
+    vfloat neg = h - floor(h * 0.5f) * 2.0f;
+    vfloat cs  = q + 1.0f;
+    vfloat ch  = floor(cs * 0.5f);
+    vfloat cng = ch - floor(ch * 0.5f) * 2.0f;
+    sinx       = select(odd, c, s) * fma(neg, -2.0f, 1.0f);
+    cosx       = select(odd, s, c) * fma(cng, -2.0f, 1.0f);
+  }
+};
+
+struct PrecisionMedium {
+  static constexpr const char* name = "medium";
+
+  static inline vfloat sinPoly(vfloat r, vfloat z) {
+    vfloat p = fma(fma(fma(fma(-2.0366439140686167e-08f, z, 2.699828012939177e-06f), z, -1.9808744723853687e-04f), z, 8.332407772763348e-03f), z, -1.6666553473432208e-01f);
+    return fma(p, z, 9.999996040267591e-01f) * r;
+  }
+  static inline vfloat cosPoly(vfloat z) {
+    vfloat p = fma(fma(fma(fma(1.7247481964452012e-09f, z, -2.7079737087729723e-07f), z, 2.4769961746233348e-05f), z, -1.3887807581258438e-03f), z, 4.166649013118536e-02f);
+    return fma(fma(p, z, -4.999998917655735e-01f), z, 9.999999891470215e-01f);
+  }
+
+  static inline vfloat sin(vfloat x) {
+    vfloat r = reduceTwoPi(x);
+    return sinPoly(r, r * r);
+  }
+  static inline void sincos(vfloat x, vfloat& sinx, vfloat& cosx) {
+    vfloat r = reduceTwoPi(x);
+    vfloat z = r * r;
+    sinx     = sinPoly(r, z);
+    cosx     = cosPoly(z);
+  }
+};
+
+struct PrecisionLow {
+  static constexpr const char* name = "low";
+
+  static inline vfloat sinPoly(vfloat r, vfloat z) {
+    vfloat p = fma(fma(fma(2.147886951977079e-06f, z, -1.9265031879080012e-04f), z, 8.308988118742151e-03f), z, -1.6662439583972272e-01f);
+    return fma(p, z, 9.999793975979762e-01f) * r;
+  }
+  static inline vfloat cosPoly(vfloat z) {
+    vfloat p = fma(fma(1.8791808566255946e-05f, z, -1.3392644626509847e-03f), z, 4.149600532926512e-02f);
+    return fma(fma(p, z, -4.997930791274919e-01f), z, 9.999597661765478e-01f);
+  }
+
+  static inline vfloat sin(vfloat x) {
+    vfloat r = reduceTwoPi(x);
+    return sinPoly(r, r * r);
+  }
+  static inline void sincos(vfloat x, vfloat& sinx, vfloat& cosx) {
+    vfloat r = reduceTwoPi(x);
+    vfloat z = r * r;
+    sinx     = sinPoly(r, z);
+    cosx     = cosPoly(z);
+  }
+};
+
+// sin de precisió float, o la de la política P
+template <class P = PrecisionFull>
+inline vfloat sin(vfloat x) {
+  return P::sin(x);
+}
+
+// sin i cos compartint la reducció
+template <class P = PrecisionFull>
+inline void sincos(vfloat x, vfloat& sinx, vfloat& cosx) {
+  P::sincos(x, sinx, cosx);
+}
+} // namespace simd
@@ -0,0 +1,63 @@
+#pragma once
+#include <fdm.hpp>
+#include <vector>
+
+/* MODE ESPECTRAL (LLUM BLANCA)
+ * Les longituds d'ona d'una font tèrmica o d'un LED no són coherents entre elles, per tant la intensitat mitjana és
+ * la suma de les intensitats monocromàtiques ponderades per l'espectre. Cada canal RGB és
+ *   I_c = sum_k weight_c(k) I(k),  weight_c = S(lambda) * (funcions CIE 1931 -> sRGB lineal) * dlambda,
+ * amb I(k) la mitjana temporal exacta del mode fasorial a cada nombre d'ona.
+ *
+ * Els nombres d'ona es mostregen equiespaiats (k_m = k0 + m dk), i així e^{i k_m d} per totes les mostres surt d'un
+ * sol sincos per focus: simd::vfloat::width mostres consecutives en un vector i la resta girant-lo per
+ * e^{i width dk d}. La distància de cada focus (d = r - r0, sense cancel·lació) i la seva amplitud es calculen un sol
+ * cop per punt i es comparteixen entre totes les longituds d'ona. La fase comuna k r0 no canvia |sum a e^{ikr}|, per
+ * tant no cal reduir-la en double.
+ *
+ * Amb dk el patró es repeteix a diferències de camí múltiples de 2PI / dk: cal prou mostres perquè aquest valor sigui
+ * més gran que les diferències de camí de la pantalla (64 mostres del visible donen ~47 µm). */
+namespace fdm {
+
+// Espectre de potència per longitud d'ona, lambda en metres i creixent. Entre mostres s'interpola linealment i fora
+// del rang és 0
+struct Spectrum {
+  std::vector<float> lambda;
+  std::vector<float> power;
+};
+
+// Planck a temperature kelvin, de 380 a 780 nm cada 5 nm
+Spectrum blackbodySpectrum(float temperature);
+
+// Gaussiana centrada a center amb amplada a mitja alçada fwhm (metres), una aproximació d'un LED
+Spectrum gaussianSpectrum(float center, float fwhm);
+
+// "blackbody:K", "led:centre_nm:fwhm_nm" o un fitxer amb línies "nm potència" ('#' comenta)
+bool spectrumParse(const char* spec, Spectrum& spectrum);
+
+float spectrumPower(const Spectrum& spectrum, float lambda);
+
+// Mostres de nombre d'ona i pesos RGB preparats pels kernels. Els pesos s'escalen perquè la intensitat 1 a totes les
+// longituds d'ona doni el color de la font amb el canal més brillant a 1. Les mostres de més fins a un múltiple de
+// simd::vfloat::width tenen pes 0
+struct SpectralTable {
+  float              k0 = 0.0; /* Primer nombre d'ona */
+  float              dk = 0.0; /* Pas entre nombres d'ona */
+  int                samples = 0;
+  std::vector<float> weight[3]; /* R, G, B per mostra */
+};
+
+SpectralTable spectralTable(const Spectrum& spectrum, int samples = 64);
+
+// Intensitat RGB de points punts amb la geometria ja calculada: d[i * sources + j] = r_j - r0 i amp[i * sources + j]
+// de cada focus j. rgb[3 * i + c] = sum_k weight_c(k) |sum_j amp_j e^{i k d_j}|^2. precision és KernelPrecision
+void spectralIntensity(const SpectralTable& table, const float* d, const float* amp, int points, int sources, int precision, float* rgb);
+
+// Perfil RGB a la pantalla del plot (mateixa graella que plot() uniforme): mitjana temporal de l'experiment a cada
+// longitud d'ona, (sum a / 2)^2 + |sum a e^{ikr}|^2 / 8 com integratePhasorBatch(), sumada amb els pesos de table
+struct SpectralPlot {
+  std::vector<float> x;
+  std::vector<float> rgb; /* 3 valors per punt */
+};
+
+SpectralPlot spectralPlot(experiment_t func, const SpectralTable& table, const SimulationParams& p);
+} // namespace fdm
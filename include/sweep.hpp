@@ -0,0 +1,36 @@
+#pragma once
+#include <fdm.hpp>
+#include <functional>
+#include <string>
+
+/* SWEEP DE PARÀMETRES
+ * Avalua el perfil d'intensitat per cada punt del producte cartesià d'uns eixos de paràmetres i l'envia en ordre a
+ * un sink que s'executa en un thread d'escriptura (OrderedWriter), de manera que el càlcul i l'escriptura a disc se
+ * solapen. Els threads de workerPool() calculen perfils diferents alhora i mai hi ha més de max(queueSize, threads)
+ * perfils pendents d'escriure. */
+namespace fdm {
+
+struct SweepAxis {
+  std::string        name; /* lambda, n, distance, amplada, steps, decay-exponent, resolution */
+  std::vector<float> values;
+};
+
+struct SweepPoint {
+  int                index;
+  std::vector<float> values; /* Valor de cada eix */
+  PlotAnalysis       analysis;
+};
+
+typedef std::function<void(const SweepPoint&)> SweepSink;
+
+// Assigna el paràmetre de p corresponent a name, retorna false si no es pot variar en un sweep
+bool sweepParameter(SimulationParams& p, const std::string& name, float value);
+
+// Llegeix un eix "name=start:end:count" (espaiat uniforme) o "name=v1,v2,..."
+bool sweepAxisParse(const char* spec, SweepAxis& axis);
+
+int sweepSize(const std::vector<SweepAxis>& axes);
+
+// L'últim eix és el que varia més ràpid. Cada perfil es calcula amb una còpia de params amb els valors dels eixos
+void runSweep(experiment_t func, const SimulationParams& params, const std::vector<SweepAxis>& axes, const SweepSink& sink, int queueSize = 4);
+} // namespace fdm
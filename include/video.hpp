@@ -237,7 +237,7 @@ struct SurfaceExtensions {
 struct SurfaceDesc {
   int  width  = 800;
   int  height = 600;
-  bool online = true;
+  bool online = true; /* false: hidden window, for headless runs (e.g. under xvfb-run) */
 };
 
 struct ISurface {
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fdm {
+
+/* Grup persistent de threads per repartir treball indexat.
+ * Cada bloc [begin, end) l'executa un sol thread i escriu en una sortida ja reservada, per tant el resultat no
+ * depèn del nombre de threads ni de l'ordre en que s'agafen els blocs.
+ * Es pot cridar des de diversos threads alhora: si el pool ja està executant un treball, parallelFor() fa tots els
+ * blocs al thread que crida (el resultat és el mateix). Les crides des de dins d'un bloc del mateix pool es
+ * detecten amb un flag per thread i també es fan al thread que crida. */
+class WorkerPool {
+  public:
+  // threads <= 0 utilitza std::thread::hardware_concurrency()
+  explicit WorkerPool(int threads = 0);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&)            = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // Nombre de threads que executen treball, comptant el que crida parallelFor()
+  inline int size() const { return int(workers.size()) + 1; }
+
+  // Espera que acabi el treball en curs
+  void resize(int threads);
+
+  // Executa job(begin, end) sobre [0, count) en blocs de chunk elements i espera que acabin tots
+  void parallelFor(int count, int chunk, const std::function<void(int, int)>& job);
+
+  private:
+  void workerLoop(unsigned seen);
+  void runChunks(const std::function<void(int, int)>& job, int count, int chunk);
+  void stop();
+
+  std::vector<std::thread> workers;
+  std::mutex               busy; /* L'agafa qui fa servir els workers */
+  std::mutex               mutex;
+  std::condition_variable  wake;
+  std::condition_variable  done;
+
+  const std::function<void(int, int)>* job = nullptr;
+  int                                  jobCount   = 0;
+  int                                  jobChunk   = 1;
+  std::atomic<int>                     nextChunk;
+  int                                  running    = 0;
+  unsigned                             generation = 0;
+  bool                                 exiting    = false;
+};
+
+// Pool compartit per la simulació, inicialment amb hardware_concurrency threads. Els programes el redimensionen
+// amb workerPool().resize()
+WorkerPool& workerPool();
+} // namespace fdm
@@ -69,7 +69,7 @@ struct GLFWSurface : public ISurface {
     return true;
   }
 
-  ENGINE_API Window* windowCreate(int width, int height) {
+  ENGINE_API Window* windowCreate(int width, int height, bool visible) {
 
     if (glfwInit() != GLFW_TRUE) {
       ERROR("Failed to start GLFW .\n");
@@ -83,6 +83,7 @@ struct GLFWSurface : public ISurface {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     GLFWwindow* window =
       glfwCreateWindow(width, height, "PathTracing", NULL, NULL);
@@ -127,7 +128,7 @@ struct GLFWSurface : public ISurface {
   ENGINE_API void windowDestroy(Window* window) {}
 
   GLFWSurface(SurfaceDesc desc) {
-    this->window = windowCreate(desc.width, desc.height);
+    this->window = windowCreate(desc.width, desc.height, desc.online);
     this->desc   = desc;
   }
 
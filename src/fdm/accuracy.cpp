@@ -0,0 +1,348 @@
+#include <accuracy.hpp>
+#include <aperture.hpp>
+#include <experiments.hpp>
+#include <simd.hpp>
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+namespace fdm {
+
+#define C      299792458.0L
+#define A_WAVE 5000e-10L
+
+long double referenceLight(long double x, long double y, long double t, const SimulationParams& p) {
+  long double l     = std::sqrt(x * x + y * y);
+  long double k     = 2.0L * M_PIl / p.uLambda;
+  long double w     = 2.0L * M_PIl * C / p.uLambda;
+  long double value = std::sin(l * k - t * w) * 0.5L + 0.5L;
+  if (p.LIGHT_DECAY_ENABLED) return value * std::pow(0.1L, (long double)p.LIGHT_DECAY_EXPONENT) / l;
+  return value;
+}
+
+long double referenceNet(long double x, long double y, long double off, long double t, long double separation, const SimulationParams& p) {
+  if (p.uAmpladaFixa) separation = separation / p.NCOUNT;
+  long double result = 0.0L;
+  for (int i = 0; i < p.NCOUNT; i++) result += referenceLight(x, y - p.NCOUNT * separation * 0.5L + off + i * separation, t, p);
+  if (p.uNormalitzarXarxa) return result / p.NCOUNT;
+  return result;
+}
+
+long double referenceExperiment(int index, long double x, long double y, long double t, const SimulationParams& p) {
+  long double o = 0.1e-3L;
+  if (index <= 0) return referenceLight(x, y - A_SEPARATION * 0.5L, t, p) * 0.5L + referenceLight(x, y + A_SEPARATION * 0.5L, t, p) * 0.5L;
+  if (index == 1) return referenceNet(x, y, 0.0L, t, B_SEPARATION, p);
+  if (index == 2) return referenceNet(x, y, 0.0L, t, p.uAmpladaMul, p);
+  return referenceNet(x, y, -o / 2.0L, t, C_SEPARATION, p) * 0.5L + referenceNet(x, y, o / 2.0L, t, C_SEPARATION, p) * 0.5L;
+}
+
+long double referenceIntegrate(int index, long double x, long double y, long double tP, const SimulationParams& p) {
+  long double w      = 2.0L * M_PIl * C / A_WAVE;
+  long double dt     = 2.0L * M_PIl / (p.INTEGRATION_STEPS * w);
+  long double result = 0.0L;
+  for (int i = 0; i < p.INTEGRATION_STEPS; i++) {
+    long double partial = referenceExperiment(index, x, y, i * dt + tP, p);
+    result += partial * partial;
+  }
+  return result / p.INTEGRATION_STEPS;
+}
+
+// Cada focus aporta a (0.5 + 0.5 sin(kr - wt)): <E^2> = (sum a / 2)^2 + |sum a e^{ikr}|^2 / 8
+struct ReferencePhasor {
+  const SimulationParams& p;
+  long double             dc = 0.0L, re = 0.0L, im = 0.0L;
+
+  void light(long double x, long double y, long double weight) {
+    long double l = std::sqrt(x * x + y * y);
+    long double a = weight;
+    if (p.LIGHT_DECAY_ENABLED) a *= std::pow(0.1L, (long double)p.LIGHT_DECAY_EXPONENT) / l;
+    long double phase = std::fmod(l * 2.0L * M_PIl / p.uLambda, 2.0L * M_PIl);
+    dc += a;
+    re += a * std::cos(phase);
+    im += a * std::sin(phase);
+  }
+
+  void net(long double x, long double y, long double off, long double separation, long double weight) {
+    if (p.uAmpladaFixa) separation = separation / p.NCOUNT;
+    if (p.uNormalitzarXarxa) weight = weight / p.NCOUNT;
+    for (int i = 0; i < p.NCOUNT; i++) light(x, y - p.NCOUNT * separation * 0.5L + off + i * separation, weight);
+  }
+};
+
+long double referencePhasor(int index, long double x, long double y, const SimulationParams& p) {
+  ReferencePhasor sum{p};
+  long double     o = 0.1e-3L;
+  if (index <= 0) {
+    sum.light(x, y - A_SEPARATION * 0.5L, 0.5L);
+    sum.light(x, y + A_SEPARATION * 0.5L, 0.5L);
+  } else if (index == 1) {
+    sum.net(x, y, 0.0L, B_SEPARATION, 1.0L);
+  } else if (index == 2) {
+    sum.net(x, y, 0.0L, p.uAmpladaMul, 1.0L);
+  } else {
+    sum.net(x, y, -o / 2.0L, C_SEPARATION, 0.5L);
+    sum.net(x, y, o / 2.0L, C_SEPARATION, 0.5L);
+  }
+  return sum.dc * sum.dc * 0.25L + (sum.re * sum.re + sum.im * sum.im) * 0.125L;
+}
+
+// CONFIGURACIONS CANÒNIQUES
+struct AccuracyConfig {
+  int   experiment;
+  int   n;
+  float distance;
+  bool  decay;
+  bool  ampladaFixa;
+  bool  normalitzar;
+  float lambda;
+};
+
+static const AccuracyConfig accuracyConfigs[] = {
+  {0, 2, 0.2, false, false, false, 5000e-10},  {1, 10, 0.2, false, false, false, 5000e-10},
+  {2, 50, 0.2, false, false, false, 5000e-10}, {2, 50, 1.0, false, false, false, 6500e-10},
+  {2, 10, 0.2, true, false, false, 5000e-10},  {2, 20, 0.5, false, true, true, 4000e-10},
+  {3, 10, 0.5, false, false, false, 5000e-10}, {3, 50, 0.2, true, false, true, 5000e-10},
+};
+
+// L'avaluació jeràrquica només val la pena amb milers de focus: xarxes de 1000 línies per mm
+static const AccuracyConfig treeConfigs[] = {
+  {2, 10000, 0.2, false, false, false, 5000e-10},
+  {3, 5000, 0.5, true, false, true, 6500e-10},
+};
+
+// Pressupostos d'error relatiu al màxim de la referència. Els camins escalars calculen la fase kr ~ 1e6 rad en
+// float, i el seu error és el de l'arrodoniment de la fase, no el del mètode
+#define BUDGET_SCALAR   0.6  /* integrate() en float */
+#define BUDGET_KERNEL   0.0  /* Kernel especialitzat: idèntic a integrate() */
+#define BUDGET_SAMPLED  2e-5 /* integrateBatch() amb PHASE_REFERENCE, precisió completa */
+#define BUDGET_PHASOR   2e-5 /* integratePhasorBatch(), precisió completa */
+#define BUDGET_FARFIELD 1e-3 /* integrateFarFieldBatch() amb F < plotting_fresnel */
+#define BUDGET_FFT      2e-3 /* apertureFarField() contra la suma directa */
+#define BUDGET_TREE     1e-4 /* integrateTreeBatch() amb plotting_tree_error = 1e-4 */
+#define BUDGET_KERNEL_MEDIUM 5e-5 /* integrateBatch()/integratePhasorBatch() amb PRECISION_MEDIUM */
+#define BUDGET_KERNEL_LOW    5e-4 /* integrateBatch()/integratePhasorBatch() amb PRECISION_LOW */
+#define BUDGET_SIN_FULL      2e-7 /* Error absolut de simd::sin/sincos per nivell */
+#define BUDGET_SIN_MEDIUM    1e-6
+#define BUDGET_SIN_LOW       1e-4
+#define BUDGET_MEAN     1e-6 /* Referència mostrejada (guardada en float) contra la tancada amb uLambda = A_WAVE */
+#define BUDGET_MODES    4e-5 /* integrateBatch() contra integratePhasorBatch() amb uLambda = A_WAVE */
+
+static const int kernelPrecisions[] = {PRECISION_FULL, PRECISION_MEDIUM, PRECISION_LOW};
+
+// "simd sampled", "simd sampled medium", ...
+static std::string precisionPath(const char* path, int precision) {
+  if (precision == PRECISION_FULL) return path;
+  return std::string(path) + " " + kernelPrecisionName(precision);
+}
+
+// Error absolut de sin i cos del nivell P per |x| <= 1e5 rad, que cobreix les fases relatives al centre de la
+// xarxa. Per sobre de ~1e6 rad la reducció en float perd precisió a tots els nivells
+template <class P>
+static AccuracyCheck sinCheck(double budget) {
+  using simd::vfloat;
+  const int     W    = vfloat::width;
+  std::string   path = std::string("sin ") + P::name;
+  AccuracyCheck res  = {path, "sin/cos, |x| <= 1e5 rad", budget, 0.0, 0.0f, 0.0, 0.0};
+
+  float x[W], s[W], c[W], s2[W];
+  for (int i = 0; i < 400000; i += W) {
+    for (int j = 0; j < W; j++) {
+      int n = i + j;
+      x[j]  = n < 200000 ? (n - 100000) * 1.3e-4f : (n - 300000) * 0.99997f;
+    }
+    vfloat vs, vc;
+    simd::sincos<P>(vfloat::load(x), vs, vc);
+    simd::sin<P>(vfloat::load(x)).store(s2);
+    vs.store(s);
+    vc.store(c);
+
+    for (int j = 0; j < W; j++) {
+      double rs = double(std::sin((long double)x[j])), rc = double(std::cos((long double)x[j]));
+      for (auto [value, reference] : {std::pair<float, double>{s[j], rs}, {c[j], rc}, {s2[j], rs}}) {
+        double e = std::abs(value - reference);
+        if (e <= res.error) continue;
+        res.error     = e;
+        res.y         = x[j];
+        res.value     = value;
+        res.reference = reference;
+      }
+    }
+  }
+  return res;
+}
+
+static std::string configName(const AccuracyConfig& config) {
+  std::ostringstream res;
+  res << "experiment " << "ABCD"[config.experiment] << ", N = " << config.n << ", L = " << config.distance << " m, lambda = " << config.lambda * 1e9 << " nm";
+  if (config.decay) res << ", decay";
+  if (config.ampladaFixa) res << ", amplada fixa";
+  if (config.normalitzar) res << ", normalitzar";
+  return res.str();
+}
+
+static AccuracyCheck compare(const std::string& path, const std::string& config, double budget, const std::vector<float>& y,
+                             const std::vector<float>& value, const std::vector<long double>& reference) {
+  AccuracyCheck res = {path, config, budget, 0.0, 0.0f, 0.0, 0.0};
+
+  long double peak = 0.0L;
+  for (long double r : reference) peak = std::max(peak, std::abs(r));
+  for (size_t i = 0; i < y.size(); i++) {
+    double error = double(std::abs(value[i] - reference[i]) / std::max(peak, 1e-300L));
+    if (error > res.error || i == 0) {
+      res.error     = error;
+      res.y         = y[i];
+      res.value     = value[i];
+      res.reference = double(reference[i]);
+    }
+  }
+  return res;
+}
+
+std::vector<AccuracyCheck> runAccuracyChecks(const std::string& paths, int points) {
+  auto selected = [&](const char* path) {
+    if (paths == "all") return true;
+    std::istringstream list(paths);
+    std::string        name;
+    while (std::getline(list, name, ','))
+      if (name == path) return true;
+    return false;
+  };
+
+  std::vector<float> y(points);
+  for (int i = 0; i < points; i++) y[i] = (i - points / 2) * 1e-4f + 0.37e-5f;
+
+  std::vector<AccuracyCheck> res;
+  if (selected("sin full")) res.push_back(sinCheck<simd::PrecisionFull>(BUDGET_SIN_FULL));
+  if (selected("sin medium")) res.push_back(sinCheck<simd::PrecisionMedium>(BUDGET_SIN_MEDIUM));
+  if (selected("sin low")) res.push_back(sinCheck<simd::PrecisionLow>(BUDGET_SIN_LOW));
+
+  std::vector<float>         value(points), scalar(points);
+  std::vector<long double>   sampled(points), phasor(points);
+  for (const AccuracyConfig& config : accuracyConfigs) {
+    SimulationParams p;
+    p.NCOUNT              = config.n;
+    p.LIGHT_DECAY_ENABLED = config.decay;
+    p.uAmpladaFixa        = config.ampladaFixa;
+    p.uNormalitzarXarxa   = config.normalitzar;
+    p.uLambda             = config.lambda;
+    p.plotting_distance   = config.distance;
+
+    std::string  name = configName(config);
+    float        x    = config.distance;
+    experiment_t func = experimentSelect(config.experiment);
+    for (int i = 0; i < points; i++) {
+      sampled[i] = referenceIntegrate(config.experiment, x, y[i], 0.0L, p);
+      phasor[i]  = referencePhasor(config.experiment, x, y[i], p);
+      scalar[i]  = integrate(glm::vec2(x, y[i]), 0.0, func, p);
+    }
+
+    if (selected("scalar")) res.push_back(compare("scalar", name, BUDGET_SCALAR, y, scalar, sampled));
+
+    const ExperimentKernel* kernel = findExperimentKernel(func);
+    if (kernel && selected("specialised kernel")) {
+      kernel->integrate[kernelMode(p)](x, y.data(), points, 0.0, p, value.data());
+      std::vector<long double> reference(scalar.begin(), scalar.end());
+      res.push_back(compare("specialised kernel", name, BUDGET_KERNEL, y, value, reference));
+    }
+
+    std::vector<ExperimentSource> sources = experimentSources(func, p);
+    for (int precision : kernelPrecisions) {
+      p.KERNEL_PRECISION = precision;
+      double      budgetLow = precision == PRECISION_LOW ? BUDGET_KERNEL_LOW : BUDGET_KERNEL_MEDIUM;
+      std::string path      = precisionPath("simd sampled", precision);
+      if (selected(path.c_str())) {
+        integrateBatch(x, y.data(), points, 0.0, sources, p, value.data());
+        res.push_back(compare(path, name, precision == PRECISION_FULL ? BUDGET_SAMPLED : budgetLow, y, value, sampled));
+      }
+      path = precisionPath("simd phasor", precision);
+      if (selected(path.c_str())) {
+        integratePhasorBatch(x, y.data(), points, sources, p, value.data());
+        res.push_back(compare(path, name, precision == PRECISION_FULL ? BUDGET_PHASOR : budgetLow, y, value, phasor));
+      }
+    }
+    p.KERNEL_PRECISION = PRECISION_FULL;
+
+    // El camp llunyà només es fa servir per sota de plotting_fresnel
+    std::vector<SourceGroup> groups = experimentGroups(func, p);
+    if (selected("far field") && fresnelNumber(groups, p) < p.plotting_fresnel) {
+      integrateFarFieldBatch(x, y.data(), points, groups, p, value.data());
+      res.push_back(compare("far field", name, BUDGET_FARFIELD, y, value, phasor));
+    }
+  }
+
+  // Amb la longitud d'ona de integrate() la mitjana mostrejada és exacta, i ha de coincidir amb la tancada
+  if (selected("reference")) {
+    SimulationParams p;
+    p.uLambda = A_WAVE;
+    p.NCOUNT  = 10;
+    for (int experiment = 0; experiment < 4; experiment++) {
+      std::vector<long double> closed(points);
+      for (int i = 0; i < points; i++) {
+        value[i]  = float(referenceIntegrate(experiment, 0.2L, y[i], 0.0L, p));
+        closed[i] = referencePhasor(experiment, 0.2L, y[i], p);
+      }
+      std::string name = std::string("experiment ") + "ABCD"[experiment] + ", N = 10, L = 0.2 m, sampled vs closed form";
+      res.push_back(compare("reference", name, BUDGET_MEAN, y, value, closed));
+    }
+  }
+
+  // Pantalla mostrejada cada 1 µm, com un plot amb plotting_resolution = 6 al voltant d'un ordre de la xarxa
+  if (selected("hierarchical")) {
+    std::vector<float>       fine(points);
+    std::vector<long double> reference(points);
+    for (int i = 0; i < points; i++) fine[i] = (i - points / 2) * 1e-6f + 0.37e-7f;
+    for (const AccuracyConfig& config : treeConfigs) {
+      SimulationParams p;
+      p.NCOUNT              = config.n;
+      p.LIGHT_DECAY_ENABLED = config.decay;
+      p.uAmpladaFixa        = config.ampladaFixa;
+      p.uNormalitzarXarxa   = config.normalitzar;
+      p.uLambda             = config.lambda;
+      p.plotting_distance   = config.distance;
+      p.plotting_tree_error = 1e-4;
+      for (int i = 0; i < points; i++) reference[i] = referencePhasor(config.experiment, config.distance, fine[i], p);
+      integrateTreeBatch(config.distance, fine.data(), points, experimentSources(experimentSelect(config.experiment), p), p, value.data());
+      res.push_back(compare("hierarchical", configName(config), BUDGET_TREE, fine, value, reference));
+    }
+  }
+
+  // Els dos modes d'integració dels kernels sobre els mateixos punts: amb uLambda = A_WAVE els passos de temps de
+  // integrate() cobreixen un període sencer i la mitjana mostrejada és la tancada
+  if (selected("modes")) {
+    std::vector<float> closed(points);
+    for (int experiment = 0; experiment < 4; experiment++) {
+      for (bool decay : {false, true}) {
+        SimulationParams p;
+        p.uLambda             = A_WAVE;
+        p.NCOUNT              = 10;
+        p.LIGHT_DECAY_ENABLED = decay;
+        std::vector<ExperimentSource> sources = experimentSources(experimentSelect(experiment), p);
+        integrateBatch(0.2f, y.data(), points, 0.0, sources, p, value.data());
+        integratePhasorBatch(0.2f, y.data(), points, sources, p, closed.data());
+        std::string name = std::string("experiment ") + "ABCD"[experiment] + ", N = 10, L = 0.2 m" + (decay ? ", decay" : "") + ", sampled vs phasor";
+        res.push_back(compare("modes", name, BUDGET_MODES, y, value, std::vector<long double>(closed.begin(), closed.end())));
+      }
+    }
+  }
+
+  if (selected("aperture fft")) {
+    SimulationParams   p;
+    Aperture           aperture = apertureSlits(20, 2e-6, 1e-5, 1e-7);
+    std::vector<float> direct(points);
+    p.uLambda = 5000e-10;
+    apertureFarField(aperture, 1.0, y.data(), points, p, value.data());
+    apertureFarFieldDirect(aperture, 1.0, y.data(), points, p, direct.data());
+    res.push_back(compare("aperture fft", "20 slits of 2 um every 10 um, L = 1 m", BUDGET_FFT, y, value, std::vector<long double>(direct.begin(), direct.end())));
+
+    // Més mostres que la FFT màxima: es calcula per blocs
+    aperture = apertureSlits(2, 1e-5, 1.7e-2, 1e-9);
+    apertureFarField(aperture, 1.0, y.data(), points, p, value.data());
+    apertureFarFieldDirect(aperture, 1.0, y.data(), points, p, direct.data());
+    std::ostringstream name;
+    name << "2 slits of 10 um every 17 mm, " << aperture.transmission.size() << " samples, L = 1 m";
+    res.push_back(compare("aperture fft", name.str(), BUDGET_FFT, y, value, std::vector<long double>(direct.begin(), direct.end())));
+  }
+  return res;
+}
+} // namespace fdm
@@ -0,0 +1,108 @@
+#include <angularSpectrum.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace fdm {
+
+#define SPECTRUM_ROWS_CHUNK 8 /* Files per bloc de treball */
+
+Field2D experimentField(experiment_t func, int width, int height, float dx, const SimulationParams& p) {
+  std::vector<ExperimentSource> sources = experimentSources(func, p);
+  if (sources.empty() || width <= 0 || height <= 0) return {};
+
+  Field2D res;
+  res.width  = width;
+  res.height = height;
+  res.dx     = dx;
+  res.data.assign(size_t(width) * height, 0.0);
+
+  // A experimentA() i net() el focus és a st + (0, offset) = 0, és a dir a y = -offset
+  for (const ExperimentSource& source : sources) {
+    int row = int(std::lround(-source.offset / dx + (height - 1) * 0.5));
+    if (row >= 0 && row < height) res.data[size_t(row) * width + width / 2] += source.weight;
+  }
+  return res;
+}
+
+void AngularSpectrum::prepare(int _width, int _height, float _dx, double _lambda, double _distance) {
+  if (_width == width && _height == height && _dx == dx && _lambda == lambda && _distance == distance) return;
+  width    = _width;
+  height   = _height;
+  dx       = _dx;
+  lambda   = _lambda;
+  distance = _distance;
+
+  field.assign(size_t(width) * height, 0.0);
+  transposed.assign(size_t(width) * height, 0.0);
+  transfer.resize(size_t(width) * height);
+
+  // Límit de banda de Matsushima per una finestra de mida width dx, height dx
+  double k      = 2.0 * M_PI / lambda;
+  double limitX = 1.0 / (lambda * std::sqrt(std::pow(2.0 * distance / (width * double(dx)), 2.0) + 1.0));
+  double limitY = 1.0 / (lambda * std::sqrt(std::pow(2.0 * distance / (height * double(dx)), 2.0) + 1.0));
+
+  // Es treu la fase constant kz: H = e^{ikz (sqrt(1 - a) - 1)}, amb sqrt(1 - a) - 1 = -a / (1 + sqrt(1 - a))
+  // per no perdre precisió amb kz ~ 1e6
+  workerPool().parallelFor(width, SPECTRUM_ROWS_CHUNK, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      double fx = (i < width / 2 ? i : i - width) / (width * double(dx));
+      for (int j = 0; j < height; j++) {
+        double     fy = (j < height / 2 ? j : j - height) / (height * double(dx));
+        double     a  = lambda * lambda * (fx * fx + fy * fy);
+        complex_t& h  = transfer[size_t(i) * height + j];
+
+        if (std::abs(fx) > limitX || std::abs(fy) > limitY) h = 0.0;
+        else if (a < 1.0) h = std::polar(1.0, -k * distance * a / (1.0 + std::sqrt(1.0 - a)));
+        else h = std::exp(-k * distance * std::sqrt(a - 1.0)); /* Ona evanescent */
+      }
+    }
+  });
+}
+
+void AngularSpectrum::rows(std::vector<complex_t>& data, int rowSize, int rowCount, bool inverse) {
+  const FftPlan& plan = fftPlan(rowSize);
+  workerPool().parallelFor(rowCount, SPECTRUM_ROWS_CHUNK, [&](int begin, int end) {
+    for (int r = begin; r < end; r++) fft(plan, data.data() + size_t(r) * rowSize, inverse);
+  });
+}
+
+// src té height files de width mostres, dst en té width de height
+void AngularSpectrum::transpose(const std::vector<complex_t>& src, std::vector<complex_t>& dst, int srcWidth, int srcHeight) {
+  workerPool().parallelFor(srcWidth, SPECTRUM_ROWS_CHUNK, [&](int begin, int end) {
+    for (int i = begin; i < end; i++)
+      for (int j = 0; j < srcHeight; j++) dst[size_t(i) * srcHeight + j] = src[size_t(j) * srcWidth + i];
+  });
+}
+
+void AngularSpectrum::propagate(const Field2D& aperture, double _lambda, double _distance, std::vector<float>& intensity) {
+  int w = aperture.width, h = aperture.height;
+  intensity.assign(size_t(std::max(w, 0)) * std::max(h, 0), 0.0f);
+  if (w <= 0 || h <= 0) return;
+
+  prepare(fftSize(2 * w), fftSize(2 * h), aperture.dx, _lambda, _distance);
+
+  // L'obertura va a la cantonada de la graella amb zero-padding
+  std::fill(field.begin(), field.end(), 0.0);
+  for (int y = 0; y < h; y++) std::copy_n(aperture.data.data() + size_t(y) * w, w, field.data() + size_t(y) * width);
+
+  rows(field, width, height, false);
+  transpose(field, transposed, width, height);
+  rows(transposed, height, width, false);
+
+  workerPool().parallelFor(width, SPECTRUM_ROWS_CHUNK, [&](int begin, int end) {
+    for (size_t i = size_t(begin) * height; i < size_t(end) * height; i++) transposed[i] *= transfer[i];
+  });
+
+  rows(transposed, height, width, true);
+  transpose(transposed, field, height, width);
+  rows(field, width, height, true);
+
+  // Les dues inverses no normalitzen
+  double scale = 1.0 / (double(width) * height);
+  workerPool().parallelFor(h, SPECTRUM_ROWS_CHUNK, [&](int begin, int end) {
+    for (int y = begin; y < end; y++)
+      for (int x = 0; x < w; x++) intensity[size_t(y) * w + x] = 0.5 * std::norm(field[size_t(y) * width + x] * scale);
+  });
+}
+} // namespace fdm
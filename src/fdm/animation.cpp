@@ -0,0 +1,65 @@
+#include <animation.hpp>
+#include <orderedWriter.hpp>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace fdm {
+
+void runAnimation(const RasterView& view, const SimulationParams& p, int frames, float timeStep, const AnimationSink& sink, int queueSize) {
+  std::vector<RasterImage> spare; /* Imatges ja escrites, per no reservar memòria a cada frame */
+  std::mutex               mutex;
+
+  // El thread d'escriptura consumeix els frames en el mateix ordre en que es calculen
+  OrderedWriter<AnimationFrame> writer(
+    [&](AnimationFrame& frame) {
+      sink(frame);
+      std::lock_guard<std::mutex> lock(mutex);
+      spare.push_back(std::move(frame.image));
+    },
+    queueSize);
+
+  // Cada frame es calcula amb tot el pool de threads (rasterize() reparteix les tessel·les)
+  RasterView frameView = view;
+  for (int index = 0; index < frames; index++) {
+    AnimationFrame frame;
+    frame.index = index;
+    frame.time  = view.time + index * timeStep;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!spare.empty()) {
+        frame.image = std::move(spare.back());
+        spare.pop_back();
+      }
+    }
+    frameView.time = frame.time;
+    rasterize(frameView, p, frame.image);
+    writer.push(index, std::move(frame));
+  }
+  writer.finish();
+}
+
+void writeY4mHeader(FILE* file, int width, int height, int fps) {
+  fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 Cmono\n", width, height, std::max(fps, 1));
+}
+
+void writeY4mFrame(FILE* file, const RasterImage& image, float exposure) {
+  // El buffer de 8 bits es reaprofita entre els frames que escriu el mateix thread
+  static thread_local std::vector<uint8_t> pixels;
+  pixels.resize(image.data.size());
+  imageToBytes(image, exposure, pixels.data());
+  fputs("FRAME\n", file);
+  fwrite(pixels.data(), 1, pixels.size(), file);
+}
+
+void writeRawHeader(FILE* file, int width, int height, int frames) {
+  int header[] = {1, width, height, frames};
+  fwrite("FDMA", 1, 4, file);
+  fwrite(header, sizeof(int), 4, file);
+}
+
+void writeRawFrame(FILE* file, const AnimationFrame& frame) {
+  fwrite(&frame.time, sizeof(float), 1, file);
+  fwrite(frame.image.data.data(), sizeof(float), frame.image.data.size(), file);
+}
+} // namespace fdm
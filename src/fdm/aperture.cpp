@@ -0,0 +1,187 @@
+#include <aperture.hpp>
+#include <fft.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace fdm {
+
+#define APERTURE_MAX_FFT    (1 << 24) /* Mida màxima de la FFT amb zero-padding */
+#define APERTURE_OVERSAMPLE 8         /* Zero-padding mínim respecte a les mostres de l'obertura */
+#define APERTURE_BLOCK      (1 << 16) /* Mostres per bloc de les obertures que no caben a APERTURE_MAX_FFT */
+
+// Obre les mostres amb |x_m - center| <= width / 2
+static void apertureOpen(Aperture& aperture, double center, double width, float value) {
+  int    size   = aperture.transmission.size();
+  double origin = (size - 1) * 0.5;
+  for (int m = 0; m < size; m++) {
+    double xm = (m - origin) * aperture.dx;
+    if (std::abs(xm - center) <= width * 0.5) aperture.transmission[m] = value;
+  }
+}
+
+Aperture apertureSlits(int count, float width, float spacing, float dx) {
+  Aperture res;
+  res.dx = dx;
+  res.transmission.resize(std::max(1, int(std::ceil(((count - 1) * double(spacing) + width) / dx)) + 1), 0.0f);
+  for (int i = 0; i < count; i++) apertureOpen(res, (i - (count - 1) * 0.5) * spacing, width, 1.0f);
+  return res;
+}
+
+Aperture apertureRandom(int cells, float cell, float fill, unsigned seed, float dx) {
+  Aperture res;
+  res.dx = dx;
+  res.transmission.resize(std::max(1, int(std::ceil(double(cells) * cell / dx))), 0.0f);
+
+  std::mt19937                          random(seed);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  for (int i = 0; i < cells; i++)
+    if (uniform(random) < fill) apertureOpen(res, (i - (cells - 1) * 0.5) * cell, cell, 1.0f);
+  return res;
+}
+
+void apertureApodise(Aperture& aperture, float sigma) {
+  int    size   = aperture.transmission.size();
+  double origin = (size - 1) * 0.5;
+  for (int m = 0; m < size; m++) {
+    double xm = (m - origin) * aperture.dx;
+    aperture.transmission[m] *= std::exp(-0.5 * xm * xm / (double(sigma) * sigma));
+  }
+}
+
+bool apertureParse(const char* spec, float dx, Aperture& aperture) {
+  int      count, cells;
+  float    width, spacing, cell, fill;
+  unsigned seed;
+  if (sscanf(spec, "slits:%d:%f:%f", &count, &width, &spacing) == 3) {
+    if (count < 1 || width <= 0.0) return false;
+    aperture = apertureSlits(count, width, spacing, dx);
+    return true;
+  }
+  if (sscanf(spec, "random:%d:%f:%f:%u", &cells, &cell, &fill, &seed) == 4) {
+    if (cells < 1 || cell <= 0.0) return false;
+    aperture = apertureRandom(cells, cell, fill, seed, dx);
+    return true;
+  }
+
+  FILE* file = fopen(spec, "r");
+  if (!file) return false;
+  aperture.dx = dx;
+  aperture.transmission.clear();
+  float value;
+  while (fscanf(file, "%f", &value) == 1) aperture.transmission.push_back(value);
+  bool valid = feof(file) && !aperture.transmission.empty();
+  fclose(file);
+  return valid;
+}
+
+// Espectre de període spectrum.size() (potència de 2) a la posició pos en mostres, interpolat amb Catmull-Rom
+static complex_t spectrumAt(const std::vector<complex_t>& spectrum, double pos) {
+  int    fsize = spectrum.size();
+  double bin   = std::floor(pos);
+  double f     = pos - bin;
+
+  int       j  = int(bin - std::floor(bin / fsize) * fsize);
+  complex_t p0 = spectrum[(j + fsize - 1) & (fsize - 1)], p1 = spectrum[j];
+  complex_t p2 = spectrum[(j + 1) & (fsize - 1)], p3 = spectrum[(j + 2) & (fsize - 1)];
+  return p1 + 0.5 * f * (p2 - p0 + f * (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3 + f * (3.0 * (p1 - p2) + p3 - p0)));
+}
+
+void apertureFarField(const Aperture& aperture, float x, const float* y, int count, const SimulationParams& p, float* out) {
+  size_t size = aperture.transmission.size();
+  if (size == 0 || count <= 0) {
+    std::fill(out, out + std::max(count, 0), 0.0f);
+    return;
+  }
+
+  double lambda = p.uLambda, dx = aperture.dx;
+
+  // Obertures massa grans per una sola FFT amb APERTURE_OVERSAMPLE: U = sum_b e^{-ik b L dx sin(theta)} U_b amb
+  // l'espectre de cada bloc de L = APERTURE_BLOCK mostres, que sí que es pot interpolar. Els blocs buits no aporten
+  if (size * APERTURE_OVERSAMPLE > APERTURE_MAX_FFT) {
+    int                    fsize = fftSize(APERTURE_BLOCK * APERTURE_OVERSAMPLE);
+    const FftPlan&         plan  = fftPlan(fsize);
+    std::vector<complex_t> spectrum(fsize), sum(count, 0.0);
+    for (size_t begin = 0; begin < size; begin += APERTURE_BLOCK) {
+      size_t end = std::min(size, begin + APERTURE_BLOCK);
+      if (std::all_of(aperture.transmission.begin() + begin, aperture.transmission.begin() + end, [](float t) { return t == 0.0f; })) continue;
+      std::fill(spectrum.begin(), spectrum.end(), 0.0);
+      for (size_t m = begin; m < end; m++) spectrum[m - begin] = aperture.transmission[m] * dx;
+      fft(plan, spectrum.data());
+
+      for (int i = 0; i < count; i++) {
+        double s     = y[i] / std::sqrt(double(x) * x + double(y[i]) * y[i]);
+        double shift = begin * dx * s / lambda;
+        sum[i] += std::polar(1.0, -2.0 * M_PI * (shift - std::floor(shift))) * spectrumAt(spectrum, s * fsize * dx / lambda);
+      }
+    }
+    for (int i = 0; i < count; i++) out[i] = std::norm(sum[i]) / (lambda * std::sqrt(double(x) * x + double(y[i]) * y[i]));
+    return;
+  }
+
+  // Pas mínim en sin(theta) entre punts consecutius de la pantalla. La FFT de mida M' té un pas de
+  // lambda / (M' dx) en sin(theta), i es vol com a molt la meitat. Amb M' >= APERTURE_OVERSAMPLE M l'espectre
+  // és prou suau entre mostres per interpolar-lo amb Catmull-Rom
+  double step = 1.0;
+  for (int i = 1; i < count; i++) {
+    double s0 = y[i - 1] / std::sqrt(double(x) * x + double(y[i - 1]) * y[i - 1]);
+    double s1 = y[i] / std::sqrt(double(x) * x + double(y[i]) * y[i]);
+    if (s1 != s0) step = std::min(step, std::abs(s1 - s0));
+  }
+  double wanted = std::min(2.0 * lambda / (step * dx), double(APERTURE_MAX_FFT));
+  int    fsize  = fftSize(std::max(int(size) * APERTURE_OVERSAMPLE, int(wanted)));
+
+  const FftPlan&         plan = fftPlan(fsize);
+  std::vector<complex_t> spectrum(fsize);
+  for (size_t m = 0; m < size; m++) spectrum[m] = aperture.transmission[m] * dx;
+  fft(plan, spectrum.data());
+
+  // La primera mostra és a x_0 = -(M - 1) dx / 2: el factor e^{-ik x_0 s} no canvia |U|. L'espectre és periòdic de
+  // període fsize
+  for (int i = 0; i < count; i++) {
+    double r = std::sqrt(double(x) * x + double(y[i]) * y[i]);
+    out[i]   = std::norm(spectrumAt(spectrum, y[i] / r * fsize * dx / lambda)) / (lambda * r);
+  }
+}
+
+void apertureFarFieldDirect(const Aperture& aperture, float x, const float* y, int count, const SimulationParams& p, float* out) {
+  size_t size   = aperture.transmission.size();
+  double k      = 2.0 * M_PI / double(p.uLambda);
+  double origin = (size - 1) * 0.5;
+
+  // Les mostres tancades no aporten: amb escletxes estretes en una obertura llarga la suma es fa només sobre les obertes
+  std::vector<size_t> open;
+  for (size_t m = 0; m < size; m++)
+    if (aperture.transmission[m] != 0.0f) open.push_back(m);
+
+  for (int i = 0; i < count; i++) {
+    double    r = std::sqrt(double(x) * x + double(y[i]) * y[i]);
+    double    s = y[i] / r;
+    complex_t u = 0.0;
+    for (size_t m : open) u += double(aperture.transmission[m]) * std::polar(1.0, -k * (m - origin) * aperture.dx * s);
+    out[i] = std::norm(u * double(aperture.dx)) / (p.uLambda * r);
+  }
+}
+
+PlotResult plotAperture(const Aperture& aperture, const SimulationParams& p) {
+  float x     = p.plotting_distance;
+  float dy    = pow(10.0, -p.plotting_resolution);
+  int   count = std::max(p.plotting_count, 0);
+
+  float      current = -dy * count / 2;
+  PlotResult res;
+  for (int i = 0; i < count; i++) {
+    res.x.push_back(current);
+    current += dy;
+  }
+
+  // El camp llunyà és la mitjana temporal exacta |U|^2, com el mode fasorial, sigui quin sigui p.INTEGRATION_MODE
+  res.path = PLOT_PATH_FFT;
+  res.mode = INTEGRATION_PHASOR;
+  res.y.resize(count);
+  apertureFarField(aperture, x, res.x.data(), count, p, res.y.data());
+  return res;
+}
+} // namespace fdm
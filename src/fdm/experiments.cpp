@@ -0,0 +1,37 @@
+#include <experiments.hpp>
+#include <deque>
+#include <mutex>
+
+namespace fdm {
+
+// Els kernels es guarden en un deque perquè push_back no mogui els ja registrats: findExperimentKernel() en torna
+// l'adreça i plot() la fa servir des del PlotWorker mentre un altre thread pot estar registrant
+static std::mutex registryMutex;
+
+static std::deque<ExperimentKernel>& registry() {
+  static std::deque<ExperimentKernel> kernels = {
+    makeExperimentKernel<ExperimentA>("A", experimentA),
+    makeExperimentKernel<ExperimentB>("B", experimentB),
+    makeExperimentKernel<ExperimentC>("C", experimentC),
+    makeExperimentKernel<ExperimentD>("D", experimentD),
+  };
+  return kernels;
+}
+
+std::vector<ExperimentKernel> experimentRegistry() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  return std::vector<ExperimentKernel>(registry().begin(), registry().end());
+}
+
+void registerExperiment(const ExperimentKernel& kernel) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry().push_back(kernel);
+}
+
+const ExperimentKernel* findExperimentKernel(experiment_t func) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (const ExperimentKernel& kernel : registry())
+    if (kernel.func == func) return &kernel;
+  return nullptr;
+}
+} // namespace fdm
@@ -0,0 +1,68 @@
+#include <fdm.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace fdm {
+
+// Mateixa geometria que net(): els focus comencen a -n * separation / 2 + off, per tant el centre queda a
+// off - separation / 2
+static void netGroup(std::vector<SourceGroup>& groups, float off, float separation, float weight, const SimulationParams& p) {
+  if (p.uAmpladaFixa)
+    separation = separation / float(p.NCOUNT);
+  if (p.uNormalitzarXarxa)
+    weight = weight / float(p.NCOUNT);
+  groups.push_back({off - separation * 0.5f, separation, p.NCOUNT, weight});
+}
+
+std::vector<SourceGroup> experimentGroups(experiment_t func, const SimulationParams& p) {
+  std::vector<SourceGroup> groups;
+  if (func == experimentA) {
+    groups.push_back({0.0f, float(A_SEPARATION), 2, 0.5f});
+  } else if (func == experimentB) {
+    netGroup(groups, 0.0, B_SEPARATION, 1.0f, p);
+  } else if (func == experimentC) {
+    netGroup(groups, 0.0, p.uAmpladaMul, 1.0f, p);
+  } else if (func == experimentD) {
+    float o = 0.1e-3;
+    netGroup(groups, -o / 2.0, C_SEPARATION, 0.5f, p);
+    netGroup(groups, o / 2.0, C_SEPARATION, 0.5f, p);
+  }
+  return groups;
+}
+
+float fresnelNumber(const std::vector<SourceGroup>& groups, const SimulationParams& p) {
+  double width = 0.0;
+  for (const SourceGroup& group : groups) width = std::max(width, (group.count - 1) * double(group.spacing) * 0.5);
+  return width * width / (double(p.uLambda) * p.plotting_distance);
+}
+
+// sin(n phi / 2) / sin(phi / 2), amb el límit n cos(n phi / 2) / cos(phi / 2) als zeros del denominador
+static double arrayFactor(int n, double phi) {
+  double d = std::sin(phi * 0.5);
+  if (std::abs(d) < 1e-9) return n * std::cos(n * phi * 0.5) / std::cos(phi * 0.5);
+  return std::sin(n * phi * 0.5) / d;
+}
+
+void integrateFarFieldBatch(float x, const float* y, int count, const std::vector<SourceGroup>& groups, const SimulationParams& p, float* out) {
+  double k     = 2.0 * M_PI / double(p.uLambda);
+  double decay = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+
+  for (int i = 0; i < count; i++) {
+    double dc = 0.0, re = 0.0, im = 0.0;
+    for (const SourceGroup& group : groups) {
+      // r_j ~ r + s_j (y + center) / r per cada focus a una distància s_j del centre del grup
+      double yc    = double(y[i]) + group.center;
+      double r     = std::sqrt(double(x) * x + yc * yc);
+      double amp   = p.LIGHT_DECAY_ENABLED ? group.weight * decay / r : group.weight;
+      double af    = arrayFactor(group.count, k * group.spacing * yc / r);
+      double phase = std::fmod(k * r, 2.0 * M_PI);
+
+      dc += amp * group.count;
+      re += amp * af * std::cos(phase);
+      im += amp * af * std::sin(phase);
+    }
+    dc *= 0.5;
+    out[i] = dc * dc + (re * re + im * im) * 0.125;
+  }
+}
+} // namespace fdm
@@ -0,0 +1,65 @@
+#include <fft.hpp>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace fdm {
+
+int fftSize(int n) {
+  int size = 1;
+  while (size < n) size <<= 1;
+  return size;
+}
+
+static FftPlan makePlan(int size) {
+  FftPlan plan;
+  plan.size = size;
+  plan.reverse.resize(size);
+
+  int bits = 0;
+  while ((1 << bits) < size) bits++;
+  for (int i = 0; i < size; i++) {
+    int r = 0;
+    for (int b = 0; b < bits; b++)
+      if (i & (1 << b)) r |= 1 << (bits - 1 - b);
+    plan.reverse[i] = r;
+  }
+
+  plan.twiddles.resize(size / 2);
+  for (int j = 0; j < size / 2; j++) plan.twiddles[j] = std::polar(1.0, -2.0 * M_PI * j / size);
+  return plan;
+}
+
+const FftPlan& fftPlan(int size) {
+  static std::mutex                                    mutex;
+  static std::map<int, std::unique_ptr<const FftPlan>> plans;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<const FftPlan>& plan = plans[size];
+  if (!plan) plan.reset(new FftPlan(makePlan(size)));
+  return *plan;
+}
+
+void fft(const FftPlan& plan, complex_t* data, bool inverse) {
+  int size = plan.size;
+  for (int i = 0; i < size; i++)
+    if (i < plan.reverse[i]) std::swap(data[i], data[plan.reverse[i]]);
+
+  // Papallones: a cada etapa els twiddles de mida len són els de size amb pas size / len
+  for (int len = 2; len <= size; len <<= 1) {
+    int half = len / 2, step = size / len;
+    for (int start = 0; start < size; start += len) {
+      for (int j = 0; j < half; j++) {
+        complex_t w = plan.twiddles[j * step];
+        if (inverse) w = std::conj(w);
+        complex_t a = data[start + j];
+        complex_t b = data[start + j + half] * w;
+
+        data[start + j]        = a + b;
+        data[start + j + half] = a - b;
+      }
+    }
+  }
+}
+} // namespace fdm
@@ -0,0 +1,59 @@
+#include <peaks.hpp>
+#include <algorithm>
+
+namespace fdm {
+
+PeakDetector::PeakDetector(int _window) : window(_window) {
+  // La finestra i la cua tenen com a molt 2 window + 1 elements; amb mida potència de 2 el mòdul és una màscara
+  int capacity = 1;
+  while (capacity < 2 * window + 1) capacity <<= 1;
+  mask = capacity - 1;
+  history.resize(capacity);
+  queueIndex.resize(capacity);
+  queueValue.resize(capacity);
+}
+
+void PeakDetector::reset() {
+  count        = 0;
+  head         = 0;
+  tail         = 0;
+  pendingCount = 0;
+}
+
+void PeakDetector::push(const float* data, int dataCount, std::vector<int>& peaks) {
+  if (window < 0) {
+    count += dataCount;
+    return;
+  }
+
+  for (int n = 0; n < dataCount; n++) {
+    int   e     = count++;
+    float value = data[n];
+
+    // Amb finestra buida tots els índexs amb una mostra posterior són màxims
+    if (window == 0) {
+      if (e >= 1) peaks.push_back(e - 1);
+      continue;
+    }
+
+    // Els candidats s'emeten quan arriba la mostra i + window + 1, com el límit del bucle original
+    while (pendingCount > 0 && pending[0] + window + 1 <= e) {
+      peaks.push_back(pending[0]);
+      pending[0] = pending[1];
+      pendingCount--;
+    }
+
+    history[e & mask] = value;
+    while (tail != head && queueValue[(tail - 1) & mask] < value) tail--;
+    queueIndex[tail & mask] = e;
+    queueValue[tail & mask] = value;
+    tail++;
+
+    // La mostra e tanca la finestra [i - window, i + window) de i = e - window + 1
+    int i = e - window + 1;
+    if (i < window) continue;
+    while (queueIndex[head & mask] < i - window) head++;
+    if (history[i & mask] >= queueValue[head & mask]) pending[pendingCount++] = i;
+  }
+}
+} // namespace fdm
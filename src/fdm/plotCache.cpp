@@ -0,0 +1,91 @@
+#include <fdm.hpp>
+#include <peaks.hpp>
+#include <algorithm>
+#include <utility>
+
+namespace fdm {
+
+#define ANALYSIS_CHUNK 4096 /* Mostres per bloc del detector de màxims */
+
+// FNV-1a sobre la representació binària de cada paràmetre
+struct KeyHasher {
+  uint64_t hash = 14695981039346656037ull;
+
+  template <typename T>
+  KeyHasher& operator<<(const T& value) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+    for (size_t i = 0; i < sizeof(T); i++) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    return *this;
+  }
+};
+
+uint64_t plotKey(experiment_t func, const SimulationParams& p) {
+  KeyHasher key;
+  key << func << p.NCOUNT << p.INTEGRATION_STEPS << p.INTEGRATION_MODE;
+  key << p.LIGHT_DECAY_ENABLED << p.LIGHT_DECAY_EXPONENT << p.PHASE_REFERENCE << p.KERNEL_PRECISION;
+  key << p.uLambda << p.uAmpladaMul << p.uAmpladaFixa << p.uNormalitzarXarxa;
+  key << p.plotting_distance << p.plotting_resolution << p.plotting_count << p.plot_highpassWindow << p.plotting_fresnel;
+  key << p.plotting_adaptive << p.plotting_tree << p.plotting_tree_error;
+  // plotting_geometry_mb no hi entra: amb o sense taula de geometria el resultat és idèntic
+  return key.hash;
+}
+
+PlotAnalysis analyzePlot(experiment_t func, const SimulationParams& p) { return analyzePlot(plot(func, p), p); }
+
+PlotAnalysis analyzePlot(PlotResult data, const SimulationParams& p) {
+  PlotAnalysis res;
+  res.data = std::move(data);
+
+  // Els màxims entren al segon detector a mesura que es troben, sense una segona passada sobre yMax
+  PeakDetector peaks(p.plot_highpassWindow), peaks2(p.plot_highpassWindow);
+  int          count = res.data.y.size();
+  size_t       found = 0;
+  for (int begin = 0; begin < count; begin += ANALYSIS_CHUNK) {
+    peaks.push(res.data.y.data() + begin, std::min(ANALYSIS_CHUNK, count - begin), res.maximum);
+    for (; found < res.maximum.size(); found++) {
+      res.xMax.push_back(res.data.x[res.maximum[found]]);
+      res.yMax.push_back(res.data.y[res.maximum[found]]);
+      peaks2.push(res.yMax.back(), res.maximum2);
+    }
+  }
+  return res;
+}
+
+// Una taula per thread com cachedPlotAnalysis(). La clau són els punts i els desplaçaments, els pesos no hi entren
+const GeometryTable* cachedGeometryTable(float x, const std::vector<float>& y, const std::vector<ExperimentSource>& sources, size_t maxBytes) {
+  thread_local GeometryTable cached;
+  thread_local uint64_t      cachedKey;
+  thread_local bool          valid = false;
+
+  if (geometryTableBytes(y.size(), sources.size()) > maxBytes) return nullptr;
+
+  KeyHasher key;
+  key << x << y.size() << sources.size();
+  for (float v : y) key << v;
+  for (const ExperimentSource& source : sources) key << source.offset;
+  if (!valid || key.hash != cachedKey) {
+    buildGeometryTable(x, y.data(), y.size(), sources, cached);
+    cachedKey = key.hash;
+    valid     = true;
+  }
+  return &cached;
+}
+
+// Una entrada per thread, així cada simulació concurrent té la seva
+const PlotAnalysis& cachedPlotAnalysis(experiment_t func, const SimulationParams& p) {
+  thread_local PlotAnalysis cached;
+  thread_local uint64_t     cachedKey;
+  thread_local bool         valid = false;
+
+  uint64_t key = plotKey(func, p);
+  if (!valid || key != cachedKey) {
+    cached    = analyzePlot(func, p);
+    cachedKey = key;
+    valid     = true;
+  }
+  return cached;
+}
+} // namespace fdm
@@ -0,0 +1,62 @@
+#include <plotWorker.hpp>
+#include <utility>
+
+namespace fdm {
+
+PlotWorker::PlotWorker() : thread(&PlotWorker::loop, this) {}
+
+PlotWorker::~PlotWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exiting = true;
+  }
+  wake.notify_all();
+  thread.join();
+}
+
+void PlotWorker::request(experiment_t _func, std::shared_ptr<const SimulationParams> _params) {
+  uint64_t key = plotKey(_func, *_params);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if ((latest || pending || running) && key == requested) return;
+    func      = _func;
+    params    = std::move(_params);
+    requested = key;
+    pending   = true;
+  }
+  wake.notify_all();
+}
+
+std::shared_ptr<const PlotAnalysis> PlotWorker::result() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return latest;
+}
+
+bool PlotWorker::busy() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending || running;
+}
+
+void PlotWorker::loop() {
+  while (true) {
+    experiment_t                            current;
+    std::shared_ptr<const SimulationParams> p;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return exiting || pending; });
+      if (exiting) return;
+      current = func;
+      p       = std::move(params);
+      pending = false;
+      running = true;
+    }
+
+    // El càlcul es fa sense el mutex, amb la còpia dels paràmetres de la petició
+    auto analysis = std::make_shared<const PlotAnalysis>(analyzePlot(current, *p));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    latest  = std::move(analysis);
+    running = false;
+  }
+}
+} // namespace fdm
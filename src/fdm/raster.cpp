@@ -0,0 +1,400 @@
+#include <raster.hpp>
+#include <simd.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+// Només aquest fitxer fa servir stb_image_write: les funcions són static perquè no xoquin amb la implementació
+// de l'engine GL quan un programa enllaça les dues biblioteques
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace fdm {
+
+// Mateixes constants que fdm.glsl
+#define C         299792458.0
+#define A_WAVE    5000e-10
+#define ZOOM      1e-4
+#define TIME_ZOOM (1e-6 / C)
+
+#define RASTER_TILE 64 /* Costat de les tessel·les en píxels, 64 x 64 float = 16 KB */
+
+// net() de fdm.glsl: el resultat sempre es divideix per N, iNormalitzarXarxa no hi canvia res
+static void shaderNet(std::vector<ExperimentSource>& sources, float off, float separation, float weight, const SimulationParams& p) {
+  if (p.uAmpladaFixa)
+    separation = separation / float(p.NCOUNT);
+  float offset = -float(p.NCOUNT) * separation * 0.5 + off;
+  for (int i = 0; i < p.NCOUNT; i++) {
+    sources.push_back({offset, weight / float(p.NCOUNT)});
+    offset += separation;
+  }
+}
+
+std::vector<ExperimentSource> shaderSources(int experiment, const SimulationParams& p) {
+  std::vector<ExperimentSource> sources;
+  if (experiment <= 0) {
+    sources.push_back({float(-A_SEPARATION * 0.5), 0.5f});
+    sources.push_back({float(A_SEPARATION * 0.5), 0.5f});
+  } else if (experiment == 1) {
+    shaderNet(sources, 0.0, p.uAmpladaMul * 10.0, 1.0f, p);
+  } else if (experiment == 2) {
+    shaderNet(sources, 0.0, p.uAmpladaMul, 1.0f, p);
+  } else {
+    float o = 0.1e-3;
+    shaderNet(sources, -o / 2.0, C_SEPARATION, 0.5f, p);
+    shaderNet(sources, o / 2.0, C_SEPARATION, 0.5f, p);
+  }
+  return sources;
+}
+
+enum RasterMode {
+  RASTER_INSTANT, /* experiment(st, iTime * TIME_ZOOM) */
+  RASTER_SAMPLED, /* executar() */
+  RASTER_PHASOR,  /* executarFasor() */
+};
+
+struct RasterFrame;
+
+// Avalua count píxels d'una fila (count múltiple de vfloat::width), acc té una entrada per mostra temporal
+typedef void (*raster_row_t)(const RasterFrame& frame, const float* x, int count, float y, simd::vfloat* acc, float* out);
+
+// Tot el que no depèn del píxel, calculat un cop per frame
+struct RasterFrame {
+  int                           width;
+  int                           height;
+  float                         zoom;
+  raster_row_t                  row; /* rasterRow<P, Mode> pel mode i KERNEL_PRECISION del frame */
+  std::vector<ExperimentSource> sources;
+  std::vector<float>            x;  /* realSt().x de cada columna, completat fins a múltiple de vfloat::width */
+  std::vector<float>            tw; /* t * w de cada mostra temporal, reduït a [0, 2PI) en double */
+  float                         k;
+  double                        kRef;
+  float                         decay;
+  float                         distance2;    /* iDistance^2 */
+  double                        distance2Ref; /* En double: l'arrodoniment de iDistance^2 en float mou la fase ~0.1 rad a 0.2 m */
+  float                         steps;
+  bool                          reference;
+  bool                          decayEnabled;
+};
+
+// Una fila de count píxels (count múltiple de vfloat::width) a l'alçada y
+template <class P, int Mode>
+static void rasterRow(const RasterFrame& frame, const float* x, int count, float y, simd::vfloat* acc, float* out) {
+  using simd::vfloat;
+  const int W = vfloat::width;
+
+  for (int i = 0; i < count; i += W) {
+    vfloat xv = vfloat::load(x + i);
+    vfloat xx = xv * xv;
+    vfloat rr = xx + (frame.distance2 + y * y);
+
+    // Mateixa descomposició de la fase que PhaseBlock (simulation.cpp), amb r0 la distància al centre en 3D
+    vfloat r0, phase0;
+    if (frame.reference) {
+      float phase[W];
+      for (int j = 0; j < W; j++) {
+        double phaseRef = frame.kRef * std::sqrt(double(x[i + j]) * x[i + j] + double(y) * y + frame.distance2Ref);
+        phase[j]        = phaseRef - std::floor(phaseRef * (0.5 / M_PI)) * (2.0 * M_PI);
+      }
+      phase0 = vfloat::load(phase);
+      r0     = simd::sqrt(rr);
+    }
+
+    vfloat dc = 0.0f, re = 0.0f, im = 0.0f;
+    if (Mode == RASTER_SAMPLED) std::fill(acc, acc + frame.tw.size(), vfloat(0.0f));
+
+    for (const ExperimentSource& source : frame.sources) {
+      float  yy = y + source.offset;
+      vfloat l  = simd::sqrt(xx + (frame.distance2 + yy * yy));
+      vfloat phase;
+      if (frame.reference) phase = simd::fma(vfloat(source.offset * (2.0f * y + source.offset)) / (l + r0), frame.k, phase0);
+      else phase = l * frame.k;
+
+      // lightValue() fa servir la distància en el pla, sense iDistance
+      vfloat amp = frame.decayEnabled ? vfloat(source.weight * frame.decay) / simd::sqrt(xx + yy * yy) : vfloat(source.weight);
+
+      if (Mode == RASTER_INSTANT) {
+        dc = simd::fma(simd::fma(simd::sin<P>(phase - frame.tw[0]), 0.5f, 0.5f), amp, dc);
+      } else if (Mode == RASTER_SAMPLED) {
+        for (size_t s = 0; s < frame.tw.size(); s++) acc[s] = simd::fma(simd::sin<P>(phase - frame.tw[s]), amp, acc[s]);
+      } else {
+        vfloat sn, cs;
+        simd::sincos<P>(phase, sn, cs);
+        re = simd::fma(amp, cs, re);
+        im = simd::fma(amp, sn, im);
+      }
+    }
+
+    vfloat result;
+    if (Mode == RASTER_INSTANT) {
+      result = dc;
+    } else if (Mode == RASTER_SAMPLED) {
+      result = 0.0f;
+      for (size_t s = 0; s < frame.tw.size(); s++) result = simd::fma(acc[s], acc[s], result);
+      result = result / frame.steps;
+    } else {
+      result = simd::fma(re, re, im * im) * 0.5f;
+    }
+    result.store(out + i);
+  }
+}
+
+template <class P>
+static raster_row_t rasterRowFor(int mode) {
+  switch (mode) {
+    case RASTER_SAMPLED: return rasterRow<P, RASTER_SAMPLED>;
+    case RASTER_PHASOR: return rasterRow<P, RASTER_PHASOR>;
+    default: return rasterRow<P, RASTER_INSTANT>;
+  }
+}
+
+// realSt().y de la fila j, amb gl_FragCoord.y = height - 0.5 a la fila 0
+static float rasterY(const RasterFrame& frame, int j) {
+  float fragY = float(frame.height - j) - 0.5f;
+  return (fragY / float(frame.height) - 0.5f) * float(ZOOM) * frame.zoom;
+}
+
+static void rasterFrame(const RasterView& view, const SimulationParams& p, RasterFrame& frame) {
+  frame.width        = std::max(view.width, 0);
+  frame.height       = std::max(view.height, 0);
+  frame.zoom         = view.zoom;
+  frame.sources      = shaderSources(view.experiment, p);
+  frame.k            = 2.0 * M_PI / p.uLambda;
+  frame.kRef         = 2.0 * M_PI / double(p.uLambda);
+  frame.decay        = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+  frame.distance2    = view.distance * view.distance;
+  frame.distance2Ref = double(view.distance) * view.distance;
+  frame.reference    = p.PHASE_REFERENCE;
+  frame.decayEnabled = p.LIGHT_DECAY_ENABLED;
+
+  // realSt().x de cada columna, les columnes de més de l'última tessel·la repeteixen l'última
+  int W = simd::vfloat::width;
+  frame.x.resize(size_t(RASTER_TILE) * ((frame.width + RASTER_TILE - 1) / RASTER_TILE) + W);
+  for (int i = 0; i < int(frame.x.size()); i++) {
+    float fragX = float(std::max(std::min(i, frame.width - 1), 0)) + 0.5f;
+    frame.x[i]  = (fragX / float(frame.width) - 0.5f) * float(ZOOM) * view.zoom;
+  }
+
+  // Temps de mostreig de executar(): w és el de LAMBDA però dt el de A_WAVE, com al shader
+  int    mode = !view.integration ? RASTER_INSTANT : p.INTEGRATION_MODE == INTEGRATION_PHASOR ? RASTER_PHASOR : RASTER_SAMPLED;
+  double w    = 2.0 * M_PI * C / double(p.uLambda);
+  double tP   = double(view.time) * TIME_ZOOM;
+  frame.tw.clear();
+  frame.steps = 1;
+  if (mode == RASTER_INSTANT) {
+    frame.tw.push_back(fmod(tP * w, 2.0 * M_PI));
+  } else if (mode == RASTER_SAMPLED) {
+    int    steps = std::max(view.steps, 1);
+    double dt    = 2.0 * M_PI / (steps * (2.0 * M_PI * C / A_WAVE));
+    for (int s = 0; s < steps; s++) frame.tw.push_back(fmod((tP + s * dt) * w, 2.0 * M_PI));
+    frame.steps = steps;
+  }
+
+  switch (p.KERNEL_PRECISION) {
+    case PRECISION_MEDIUM: frame.row = rasterRowFor<simd::PrecisionMedium>(mode); break;
+    case PRECISION_LOW: frame.row = rasterRowFor<simd::PrecisionLow>(mode); break;
+    default: frame.row = rasterRowFor<simd::PrecisionFull>(mode);
+  }
+}
+
+void rasterize(const RasterView& view, const SimulationParams& p, RasterImage& image) {
+  using simd::vfloat;
+  const int W = vfloat::width;
+
+  RasterFrame frame;
+  rasterFrame(view, p, frame);
+  image.width    = frame.width;
+  image.height   = frame.height;
+  image.channels = 1;
+  image.data.assign(size_t(image.width) * image.height, 0.0f);
+  if (image.data.empty()) return;
+
+  // Cada tessel·la l'escriu un sol thread, per tant la imatge no depèn del nombre de threads
+  int tilesX = (frame.width + RASTER_TILE - 1) / RASTER_TILE;
+  int tilesY = (frame.height + RASTER_TILE - 1) / RASTER_TILE;
+  workerPool().parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+    std::vector<vfloat> acc(frame.tw.size());
+    float               row[RASTER_TILE + vfloat::width];
+
+    for (int tile = begin; tile < end; tile++) {
+      int x0     = (tile % tilesX) * RASTER_TILE;
+      int y0     = (tile / tilesX) * RASTER_TILE;
+      int width  = std::min(RASTER_TILE, frame.width - x0);
+      int height = std::min(RASTER_TILE, frame.height - y0);
+      int padded = (width + W - 1) / W * W;
+
+      for (int j = y0; j < y0 + height; j++) {
+        frame.row(frame, frame.x.data() + x0, padded, rasterY(frame, j), acc.data(), row);
+        std::copy(row, row + width, image.data.begin() + size_t(j) * frame.width + x0);
+      }
+    }
+  });
+}
+
+// La geometria de cada fila de la tessel·la (r - r0 i amplitud de cada focus per píxel) es calcula un cop i
+// spectralIntensity() la fa servir per totes les longituds d'ona
+void rasterizeSpectral(const RasterView& view, const SimulationParams& p, const SpectralTable& table, RasterImage& image) {
+  RasterFrame frame;
+  rasterFrame(view, p, frame);
+  image.width    = frame.width;
+  image.height   = frame.height;
+  image.channels = 3;
+  image.data.assign(size_t(image.width) * image.height * 3, 0.0f);
+  if (image.data.empty() || table.samples == 0) return;
+
+  int n      = frame.sources.size();
+  int tilesX = (frame.width + RASTER_TILE - 1) / RASTER_TILE;
+  int tilesY = (frame.height + RASTER_TILE - 1) / RASTER_TILE;
+  workerPool().parallelFor(tilesX * tilesY, 1, [&](int begin, int end) {
+    std::vector<float> d(size_t(RASTER_TILE) * n), amp(d.size());
+
+    for (int tile = begin; tile < end; tile++) {
+      int x0     = (tile % tilesX) * RASTER_TILE;
+      int y0     = (tile / tilesX) * RASTER_TILE;
+      int width  = std::min(RASTER_TILE, frame.width - x0);
+      int height = std::min(RASTER_TILE, frame.height - y0);
+
+      for (int j = y0; j < y0 + height; j++) {
+        float y = rasterY(frame, j);
+        for (int i = 0; i < width; i++) {
+          float  x  = frame.x[x0 + i];
+          float  r0 = std::sqrt(x * x + (frame.distance2 + y * y));
+          float* di = d.data() + size_t(i) * n;
+          float* ai = amp.data() + size_t(i) * n;
+          for (int s = 0; s < n; s++) {
+            const ExperimentSource& source = frame.sources[s];
+            float                   yy     = y + source.offset;
+            float                   l      = std::sqrt(x * x + (frame.distance2 + yy * yy));
+            di[s]                          = source.offset * (2.0f * y + source.offset) / (l + r0);
+            ai[s]                          = frame.decayEnabled ? source.weight * frame.decay / std::sqrt(x * x + yy * yy) : source.weight;
+          }
+        }
+
+        // executarFasor() retorna |sum a e^{ikr}|^2 / 2
+        float* out = image.data.data() + (size_t(j) * frame.width + x0) * 3;
+        spectralIntensity(table, d.data(), amp.data(), width, n, p.KERNEL_PRECISION, out);
+        for (int i = 0; i < width * 3; i++) out[i] *= 0.5f;
+      }
+    }
+  });
+}
+
+// RASTER PROGRESSIU
+
+// Les files de la graella de pas stride que són de la graella de 2 * stride ja tenen calculades les columnes
+// múltiples de 2 * stride, la resta de files de la graella no en tenen cap
+static bool rowKnown(int j, int stride) { return stride < PROGRESSIVE_COARSE && j % (2 * stride) == 0; }
+
+// Calcula els píxels nous de la fila j per la passada stride i interpola la resta de columnes de la fila
+static void progressiveRow(const RasterFrame& frame, int stride, int j, std::vector<float>& x, std::vector<int>& columns, std::vector<float>& out,
+                           std::vector<simd::vfloat>& acc, RasterImage& image) {
+  const int W = simd::vfloat::width;
+
+  columns.clear();
+  int step = rowKnown(j, stride) ? 2 * stride : stride;
+  for (int c = rowKnown(j, stride) ? stride : 0; c < frame.width; c += step) columns.push_back(c);
+
+  float* row = image.data.data() + size_t(j) * frame.width;
+  if (!columns.empty()) {
+    int padded = (columns.size() + W - 1) / W * W;
+    x.resize(padded);
+    out.resize(padded);
+    for (int i = 0; i < padded; i++) x[i] = frame.x[columns[std::min(i, int(columns.size()) - 1)]];
+    frame.row(frame, x.data(), padded, rasterY(frame, j), acc.data(), out.data());
+    for (size_t i = 0; i < columns.size(); i++) row[columns[i]] = out[i];
+  }
+
+  // Després de l'última columna de la graella es repeteix el seu valor
+  int last = (frame.width - 1) / stride * stride;
+  for (int c = 0; c < frame.width; c++) {
+    if (c % stride == 0) continue;
+    int a  = c / stride * stride;
+    row[c] = a == last ? row[a] : row[a] + (row[a + stride] - row[a]) * (float(c - a) / stride);
+  }
+}
+
+// Interpola les files entre j - stride i j, i després de l'última fila de la graella la repeteix
+static void progressiveBand(const RasterFrame& frame, int stride, int j, RasterImage& image) {
+  float* b = image.data.data() + size_t(j) * frame.width;
+  if (j > 0) {
+    float* a = b - size_t(stride) * frame.width;
+    for (int r = 1; r < stride; r++) {
+      float* row = a + size_t(r) * frame.width;
+      float  t   = float(r) / stride;
+      for (int c = 0; c < frame.width; c++) row[c] = a[c] + (b[c] - a[c]) * t;
+    }
+  }
+  if (j == (frame.height - 1) / stride * stride)
+    for (int r = j + 1; r < frame.height; r++) std::copy(b, b + frame.width, image.data.begin() + size_t(r) * frame.width);
+}
+
+ProgressiveRaster::ProgressiveRaster() : frame(new RasterFrame()) {}
+
+ProgressiveRaster::~ProgressiveRaster() = default;
+
+void ProgressiveRaster::request(const RasterView& _view, const SimulationParams& p) {
+  uint64_t _key = plotKey(experimentSelect(_view.experiment), p);
+  if (valid && _key == key && _view == view) return;
+  view  = _view;
+  key   = _key;
+  valid = true;
+
+  rasterFrame(view, p, *frame);
+  if (result.width != frame->width || result.height != frame->height) {
+    result.width  = frame->width;
+    result.height = frame->height;
+    result.data.assign(size_t(result.width) * result.height, 0.0f);
+  }
+  current = result.data.empty() ? 0 : PROGRESSIVE_COARSE;
+  beginPass();
+}
+
+void ProgressiveRaster::beginPass() {
+  rows.clear();
+  next = 0;
+  if (current > 0)
+    for (int j = 0; j < frame->height; j += current) rows.push_back(j);
+}
+
+bool ProgressiveRaster::step(double budgetMs) {
+  auto begin   = std::chrono::steady_clock::now();
+  bool changed = false;
+  while (!done()) {
+    // Un lot és una fila per thread. Les bandes entre files es fan quan totes les files del lot estan acabades
+    int count = std::min(workerPool().size(), int(rows.size()) - next);
+    workerPool().parallelFor(count, 1, [&](int first, int last) {
+      std::vector<float>        x, out;
+      std::vector<int>          columns;
+      std::vector<simd::vfloat> acc(frame->tw.size());
+      for (int i = first; i < last; i++) progressiveRow(*frame, current, rows[next + i], x, columns, out, acc, result);
+    });
+    workerPool().parallelFor(count, 1, [&](int first, int last) {
+      for (int i = first; i < last; i++) progressiveBand(*frame, current, rows[next + i], result);
+    });
+    next += count;
+    changed = true;
+
+    if (next == int(rows.size())) {
+      current /= 2;
+      beginPass();
+    }
+    if (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() >= budgetMs) break;
+  }
+  return changed;
+}
+
+void imageToBytes(const RasterImage& image, float exposure, uint8_t* pixels) {
+  // Valors no negatius: truncar v + 0.5 arrodoneix com lround() i es vectoritza
+  for (size_t i = 0; i < image.data.size(); i++) pixels[i] = uint8_t(std::clamp(image.data[i] * exposure, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+bool writePng(const char* path, const RasterImage& image, float exposure) {
+  if (image.data.empty()) return false;
+  std::vector<uint8_t> pixels(image.data.size());
+  imageToBytes(image, exposure, pixels.data());
+  return stbi_write_png(path, image.width, image.height, image.channels, pixels.data(), image.width * image.channels) != 0;
+}
+} // namespace fdm
@@ -0,0 +1,561 @@
+#include <fdm.hpp>
+#include <experiments.hpp>
+#include <peaks.hpp>
+#include <simd.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+namespace fdm {
+using namespace glm;
+
+// CONSTANTS (es un poc caòtic)
+#define C                  299792458.0
+#define LIGHT_DECAY_FACTOR 1.0e-5
+#define GAMMA_CORRECTED    1.0
+#define A_WAVE             5000e-10
+#define A_L                = 200.0e-3
+#define ZOOM               1e-4
+#define TIME_ZOOM          (1e-6 / C)
+
+// Paràmetres publicats, cada publicació és un objecte nou i immutable
+static std::shared_ptr<const SimulationParams> published = std::make_shared<const SimulationParams>();
+
+std::shared_ptr<const SimulationParams> publishedParams() { return std::atomic_load(&published); }
+
+void publishParams(const SimulationParams& params) { std::atomic_store(&published, std::make_shared<const SimulationParams>(params)); }
+
+
+// FUNCIONS DE LA SIMULACIÖ
+
+//Retorna el coeficient de distància amb la pantalla
+float lightValue(vec2 st, const SimulationParams& p) {
+  //Correcció per mostrar de forma dinàmica a la pantalla
+  return pow(0.1, p.LIGHT_DECAY_EXPONENT) / sqrt(st.x * st.x + st.y * st.y);
+}
+
+
+// Retorna el valor de la funció del camp elèctric en un temps t en una posició st del espai
+float light(vec2 st, float t, const SimulationParams& p) {
+  float l = length(vec3(st.x, st.y, 0));
+  float k = 2.0 * M_PI / p.uLambda;
+  float f = C / p.uLambda;
+  float w = f * 2.0 * M_PI;
+
+  float value = (sin(l * k - t * w) * 0.5 + 0.5);
+  if (p.LIGHT_DECAY_ENABLED) return value * lightValue(st, p);
+  return value;
+}
+
+
+float net(vec2 st, float off, float t, float separation, const SimulationParams& p) {
+  float result = 0.0;
+  if (p.uAmpladaFixa)
+    separation = separation / float(p.NCOUNT);
+  float offset = -float(p.NCOUNT) * separation * 0.5 + off;
+  for (int i = 0; i < p.NCOUNT; i++) {
+    result += light(st + vec2(0, offset), t, p);
+    offset += separation;
+  }
+  if (p.uNormalitzarXarxa)
+    return result / float(p.NCOUNT);
+  return result;
+}
+
+float experimentA(vec2 st, float t, const SimulationParams& p) {
+  return light(st + vec2(0.0, -A_SEPARATION * 0.5), t, p) * 0.5 + light(st + vec2(0.0, A_SEPARATION * 0.5), t, p) * 0.5;
+}
+float experimentB(vec2 st, float t, const SimulationParams& p) {
+  return net(st, 0.0, t, B_SEPARATION, p);
+}
+
+float experimentC(vec2 st, float t, const SimulationParams& p) {
+  return net(st, 0.0, t, p.uAmpladaMul, p);
+}
+
+float experimentD(vec2 st, float t, const SimulationParams& p) {
+  float o = 0.1e-3;
+  return net(st, -o / 2.0, t, C_SEPARATION, p) * 0.5 + net(st, o / 2.0, t, C_SEPARATION, p) * 0.5;
+}
+
+experiment_t experimentSelect(int index) {
+  if (index <= 0) return experimentA;
+  if (index == 1) return experimentB;
+  if (index == 2) return experimentC;
+  return experimentD;
+}
+
+KernelConstants kernelConstants(const SimulationParams& p) {
+  KernelConstants c;
+  c.k          = 2.0 * M_PI / p.uLambda;
+  float f      = C / p.uLambda;
+  c.w          = f * 2.0 * M_PI;
+  c.decay      = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+  c.n          = p.NCOUNT;
+  c.ampladaMul = p.uAmpladaMul;
+  c.steps      = p.INTEGRATION_STEPS;
+  float fI     = C / A_WAVE;
+  float wI     = fI * 2.0 * M_PI;
+  c.dt         = 2.0 * M_PI / (float(p.INTEGRATION_STEPS) * wI);
+  return c;
+}
+
+int kernelMode(const SimulationParams& p) { return (p.LIGHT_DECAY_ENABLED ? 4 : 0) | (p.uAmpladaFixa ? 2 : 0) | (p.uNormalitzarXarxa ? 1 : 0); }
+
+float integrate(vec2 st, float tP, experiment_t func, const SimulationParams& p) {
+
+  float result = 0.0;
+  float f      = C / A_WAVE;
+  float w      = f * 2.0 * M_PI;
+  float L      = float(p.INTEGRATION_STEPS);
+  float dt     = 2.0 * M_PI / (L * w);
+  float t      = 0.0;
+  for (int i = 0; i < p.INTEGRATION_STEPS; i++) {
+    float partial = func(st, t + tP, p);
+    result += partial * partial;
+    t += dt;
+  }
+  return result / L;
+}
+
+
+// KERNEL VECTORIAL
+// Els experiments A-D són sumes lineals de light(), per tant es poden descriure com una llista de focus
+// (desplaçament, pes) i avaluar-se en paral·lel sobre simd::vfloat::width punts de la pantalla.
+
+// Mateixos desplaçaments que net()
+static void netSources(std::vector<ExperimentSource>& sources, float off, float separation, float weight, const SimulationParams& p) {
+  if (p.uAmpladaFixa)
+    separation = separation / float(p.NCOUNT);
+  if (p.uNormalitzarXarxa)
+    weight = weight / float(p.NCOUNT);
+  float offset = -float(p.NCOUNT) * separation * 0.5 + off;
+  for (int i = 0; i < p.NCOUNT; i++) {
+    sources.push_back({offset, weight});
+    offset += separation;
+  }
+}
+
+std::vector<ExperimentSource> experimentSources(experiment_t func, const SimulationParams& p) {
+  std::vector<ExperimentSource> sources;
+  if (func == experimentA) {
+    sources.push_back({float(-A_SEPARATION * 0.5), 0.5f});
+    sources.push_back({float(A_SEPARATION * 0.5), 0.5f});
+  } else if (func == experimentB) {
+    netSources(sources, 0.0, B_SEPARATION, 1.0f, p);
+  } else if (func == experimentC) {
+    netSources(sources, 0.0, p.uAmpladaMul, 1.0f, p);
+  } else if (func == experimentD) {
+    float o = 0.1e-3;
+    netSources(sources, -o / 2.0, C_SEPARATION, 0.5f, p);
+    netSources(sources, o / 2.0, C_SEPARATION, 0.5f, p);
+  }
+  return sources;
+}
+
+// Fase de propagació k * r de cada focus per un bloc de punts de la pantalla.
+// La fase directa l * k arriba a ~2.5e6 rad a 0.2 m i en float només té ~0.2 rad de precisió. Amb PHASE_REFERENCE
+// es calcula com k * r0 + k * (r - r0), on r0 és la distància al centre de la xarxa: k * r0 es redueix a [0, 2PI)
+// en double un sol cop per punt, i r - r0 = o * (2y + o) / (r + r0) no té cancel·lació. L'error de fase queda en
+// ~1e-7 * k * |r - r0|, uns 1e-3 rad pels experiments del laboratori.
+struct PhaseBlock {
+  simd::vfloat y      = 0.0f; /* Sense taula */
+  simd::vfloat xx     = 0.0f;
+  simd::vfloat r0     = 0.0f; /* Amb PHASE_REFERENCE */
+  simd::vfloat phase0 = 0.0f;
+  float        k;
+  bool         reference;
+  const float* l = nullptr; /* Bloc de la taula de geometria, si n'hi ha */
+  const float* d = nullptr;
+
+  PhaseBlock(float x, const float* py, const SimulationParams& p, const GeometryTable* geometry = nullptr, int block = 0) {
+    using simd::vfloat;
+    const int W = vfloat::width;
+    k           = 2.0 * M_PI / p.uLambda;
+    reference   = p.PHASE_REFERENCE;
+    if (geometry) {
+      l = geometry->l.data() + size_t(block) * geometry->sources * W;
+      d = geometry->d.data() + size_t(block) * geometry->sources * W;
+    } else {
+      y  = vfloat::load(py);
+      xx = x * x;
+    }
+    if (reference) {
+      double kRef = 2.0 * M_PI / double(p.uLambda);
+      float  phase[W];
+      for (int j = 0; j < W; j++) phase[j] = fmod(kRef * (geometry ? geometry->r0[size_t(block) * W + j] : std::sqrt(double(x) * x + double(py[j]) * py[j])), 2.0 * M_PI);
+      phase0 = vfloat::load(phase);
+      if (!geometry) r0 = simd::sqrt(xx + y * y);
+    }
+  }
+
+  // Distància al focus index, desplaçat offset
+  inline simd::vfloat distance(int index, float offset) const {
+    if (l) return simd::vfloat::load(l + index * simd::vfloat::width);
+    simd::vfloat yy = y + offset;
+    return simd::sqrt(xx + yy * yy);
+  }
+
+  inline simd::vfloat phase(int index, float offset, simd::vfloat l) const {
+    if (!reference) return l * k;
+    if (d) return simd::fma(simd::vfloat::load(d + index * simd::vfloat::width), k, phase0);
+    return simd::fma(delta(offset, l), k, phase0);
+  }
+
+  // l - r0 = o * (2y + o) / (l + r0)
+  inline simd::vfloat delta(float offset, simd::vfloat l) const { return offset * simd::fma(y, 2.0f, offset) / (l + r0); }
+};
+
+#define GEOMETRY_CHUNK 64 /* Blocs de simd::vfloat::width punts per bloc de treball de buildGeometryTable() */
+
+size_t geometryTableBytes(int count, int sources) {
+  const int W      = simd::vfloat::width;
+  size_t    points = size_t(std::max(count, 0) + W - 1) / W * W;
+  return points * (sizeof(double) + 2 * sizeof(float) * std::max(sources, 0));
+}
+
+// Mateixes operacions que PhaseBlock sense taula, per tant els kernels llegeixen exactament els mateixos valors
+void buildGeometryTable(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, GeometryTable& table) {
+  using simd::vfloat;
+  const int W   = vfloat::width;
+  table.points  = (std::max(count, 0) + W - 1) / W * W;
+  table.sources = sources.size();
+  table.r0.resize(table.points);
+  table.l.resize(size_t(table.points) * table.sources);
+  table.d.resize(table.l.size());
+
+  SimulationParams p;
+  p.PHASE_REFERENCE = true;
+  workerPool().parallelFor(table.points / W, GEOMETRY_CHUNK, [&](int begin, int end) {
+    float tail[W];
+    for (int i = begin * W; i < end * W; i += W) {
+      const float* py = y + i;
+      if (count - i < W) {
+        for (int j = 0; j < W; j++) tail[j] = y[std::min(i + j, count - 1)];
+        py = tail;
+      }
+
+      PhaseBlock block(x, py, p);
+      for (int j = 0; j < W; j++) table.r0[i + j] = std::sqrt(double(x) * x + double(py[j]) * py[j]);
+      float* l = table.l.data() + size_t(i) * table.sources;
+      float* d = table.d.data() + size_t(i) * table.sources;
+      for (int s = 0; s < table.sources; s++) {
+        vfloat distance = block.distance(s, sources[s].offset);
+        distance.store(l + s * W);
+        block.delta(sources[s].offset, distance).store(d + s * W);
+      }
+    }
+  });
+}
+
+template <class P>
+static void integrateBatchP(float x, const float* y, int count, float tP, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                            const GeometryTable* geometry, int first) {
+  using simd::vfloat;
+  const int W = vfloat::width;
+
+  float f     = C / p.uLambda;
+  float w     = f * 2.0 * M_PI;
+  float decay = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+
+  // Els temps de mostreig són els mateixos que a integrate(), el terme t * w es comparteix entre punts i focus
+  float              fI = C / A_WAVE;
+  float              wI = fI * 2.0 * M_PI;
+  float              L  = float(p.INTEGRATION_STEPS);
+  float              dt = 2.0 * M_PI / (L * wI);
+  float              t  = 0.0;
+  std::vector<float> tw(std::max(p.INTEGRATION_STEPS, 0));
+  for (int s = 0; s < p.INTEGRATION_STEPS; s++) {
+    tw[s] = (t + tP) * w;
+    t += dt;
+  }
+
+  std::vector<vfloat> acc(tw.size());
+  float               tail[W];
+  for (int i = 0; i < count; i += W) {
+    int lanes = std::min(W, count - i);
+
+    // L'últim bloc incomplet es completa repetint l'últim punt
+    const float* py = y + i;
+    if (lanes < W) {
+      for (int j = 0; j < W; j++) tail[j] = y[i + std::min(j, lanes - 1)];
+      py = tail;
+    }
+
+    PhaseBlock block(x, py, p, geometry, (first + i) / W);
+    std::fill(acc.begin(), acc.end(), vfloat(0.0f));
+
+    for (int j = 0; j < int(sources.size()); j++) {
+      const ExperimentSource& source = sources[j];
+      vfloat                  l      = block.distance(j, source.offset);
+      vfloat                  base   = block.phase(j, source.offset, l);
+      vfloat amp  = p.LIGHT_DECAY_ENABLED ? vfloat(source.weight * decay) / l : vfloat(source.weight);
+
+      for (size_t s = 0; s < tw.size(); s++) {
+        vfloat value = simd::fma(simd::sin<P>(base - tw[s]), 0.5f, 0.5f);
+        acc[s]       = simd::fma(value, amp, acc[s]);
+      }
+    }
+
+    vfloat result = 0.0f;
+    for (size_t s = 0; s < tw.size(); s++) result = simd::fma(acc[s], acc[s], result);
+    result = result / L;
+
+    if (lanes < W) {
+      result.store(tail);
+      std::copy(tail, tail + lanes, out + i);
+    } else {
+      result.store(out + i);
+    }
+  }
+}
+
+template <class P>
+static void integratePhasorBatchP(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                                  const GeometryTable* geometry, int first) {
+  using simd::vfloat;
+  const int W = vfloat::width;
+
+  float decay = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+
+  float tail[W];
+  for (int i = 0; i < count; i += W) {
+    int lanes = std::min(W, count - i);
+
+    const float* py = y + i;
+    if (lanes < W) {
+      for (int j = 0; j < W; j++) tail[j] = y[i + std::min(j, lanes - 1)];
+      py = tail;
+    }
+
+    PhaseBlock block(x, py, p, geometry, (first + i) / W);
+    vfloat     dc = 0.0f;
+    vfloat     re = 0.0f;
+    vfloat     im = 0.0f;
+
+    for (int j = 0; j < int(sources.size()); j++) {
+      const ExperimentSource& source = sources[j];
+      vfloat                  l      = block.distance(j, source.offset);
+      vfloat                  amp    = p.LIGHT_DECAY_ENABLED ? vfloat(source.weight * decay) / l : vfloat(source.weight);
+      vfloat                  s, c;
+      simd::sincos<P>(block.phase(j, source.offset, l), s, c);
+      dc = dc + amp;
+      re = simd::fma(amp, c, re);
+      im = simd::fma(amp, s, im);
+    }
+
+    dc            = dc * 0.5f;
+    vfloat result = simd::fma(simd::fma(re, re, im * im), 0.125f, dc * dc);
+
+    if (lanes < W) {
+      result.store(tail);
+      std::copy(tail, tail + lanes, out + i);
+    } else {
+      result.store(out + i);
+    }
+  }
+}
+
+
+// La precisió es tria un sol cop per bloc de punts, dins dels kernels el sin és inlined
+void integrateBatch(float x, const float* y, int count, float tP, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                    const GeometryTable* geometry, int first) {
+  switch (p.KERNEL_PRECISION) {
+    case PRECISION_MEDIUM: integrateBatchP<simd::PrecisionMedium>(x, y, count, tP, sources, p, out, geometry, first); break;
+    case PRECISION_LOW: integrateBatchP<simd::PrecisionLow>(x, y, count, tP, sources, p, out, geometry, first); break;
+    default: integrateBatchP<simd::PrecisionFull>(x, y, count, tP, sources, p, out, geometry, first);
+  }
+}
+
+void integratePhasorBatch(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out,
+                          const GeometryTable* geometry, int first) {
+  switch (p.KERNEL_PRECISION) {
+    case PRECISION_MEDIUM: integratePhasorBatchP<simd::PrecisionMedium>(x, y, count, sources, p, out, geometry, first); break;
+    case PRECISION_LOW: integratePhasorBatchP<simd::PrecisionLow>(x, y, count, sources, p, out, geometry, first); break;
+    default: integratePhasorBatchP<simd::PrecisionFull>(x, y, count, sources, p, out, geometry, first);
+  }
+}
+
+const char* kernelPrecisionName(int precision) {
+  switch (precision) {
+    case PRECISION_MEDIUM: return simd::PrecisionMedium::name;
+    case PRECISION_LOW: return simd::PrecisionLow::name;
+    default: return simd::PrecisionFull::name;
+  }
+}
+
+
+// Funcions per trobar els valors del plot
+const char* plotPathName(int path) {
+  switch (path) {
+    case PLOT_PATH_KERNEL: return "specialised kernel";
+    case PLOT_PATH_SAMPLED: return "simd sampled";
+    case PLOT_PATH_PHASOR: return "simd phasor";
+    case PLOT_PATH_FARFIELD: return "far field";
+    case PLOT_PATH_FFT: return "aperture fft";
+    case PLOT_PATH_TREE: return "hierarchical";
+    default: return "scalar";
+  }
+}
+
+#define PLOT_CHUNK           512 /* Punts per bloc de treball dels threads del plot */
+#define PLOT_ADAPTIVE_COARSE 16  /* Pas inicial del mostreig adaptatiu, en punts de la graella uniforme */
+
+// Camí escollit per plot() i les dades que necessita
+struct PlotEvaluator {
+  const SimulationParams&           p;
+  experiment_t                      func = nullptr;
+  float                             x    = 0.0;
+  int                               path = PLOT_PATH_SCALAR;
+  std::vector<ExperimentSource>     sources;
+  std::vector<SourceGroup>          groups;
+  integrate_kernel_t                special  = nullptr;
+  const GeometryTable*              geometry = nullptr; /* Taula de ys sencer, només quan s'avalua la graella uniforme */
+  std::shared_ptr<const SourceTree> tree;               /* Taules de PLOT_PATH_TREE per tota la graella */
+
+  explicit PlotEvaluator(const SimulationParams& p) : p(p) {}
+
+  // first és la posició de ys a la taula de geometria
+  void operator()(const float* ys, int count, float* out, int first = 0) const {
+    switch (path) {
+      case PLOT_PATH_KERNEL: special(x, ys, count, 0.0, p, out); break;
+      case PLOT_PATH_SAMPLED: integrateBatch(x, ys, count, 0.0, sources, p, out, geometry, first); break;
+      case PLOT_PATH_PHASOR: integratePhasorBatch(x, ys, count, sources, p, out, geometry, first); break;
+      case PLOT_PATH_FARFIELD: integrateFarFieldBatch(x, ys, count, groups, p, out); break;
+      case PLOT_PATH_TREE:
+        if (tree) evaluateSourceTree(*tree, ys, count, out);
+        else integratePhasorBatch(x, ys, count, sources, p, out);
+        break;
+      default:
+        for (int i = 0; i < count; i++) out[i] = integrate(glm::vec2(x, ys[i]), 0.0, func, p);
+    }
+  }
+
+  // Cada punt es calcula de forma independent, per tant el resultat és el mateix amb qualsevol nombre de threads.
+  // L'avaluació jeràrquica comparteix les taules entre tots els punts i reparteix el treball ella mateixa
+  void parallel(const float* ys, int count, float* out) const {
+    if (path == PLOT_PATH_TREE && tree) return evaluateSourceTree(*tree, ys, count, out);
+    workerPool().parallelFor(count, PLOT_CHUNK, [&](int begin, int end) { (*this)(ys + begin, end - begin, out + begin, begin); });
+  }
+};
+
+// Mostreig adaptatiu sobre els punts de la graella uniforme: es comença cada PLOT_ADAPTIVE_COARSE punts i, nivell a
+// nivell, es divideix cada interval on el punt mig s'allunya de la interpolació lineal més de
+// p.plotting_adaptive * el màxim trobat. Els punts mig de cada nivell s'avaluen junts amb el mateix kernel
+static void plotAdaptive(const PlotEvaluator& evaluate, const std::vector<float>& grid, PlotResult& res) {
+  int                count = grid.size();
+  std::vector<float> values(count);
+  std::vector<char>  evaluated(count, 0);
+
+  std::vector<int> indices;
+  for (int i = 0; i < count; i += PLOT_ADAPTIVE_COARSE) indices.push_back(i);
+  if (indices.back() != count - 1) indices.push_back(count - 1);
+
+  std::vector<float> ys, out;
+  auto               evaluateIndices = [&](const std::vector<int>& list) {
+    ys.resize(list.size());
+    out.resize(list.size());
+    for (size_t i = 0; i < list.size(); i++) ys[i] = grid[list[i]];
+    evaluate.parallel(ys.data(), ys.size(), out.data());
+    for (size_t i = 0; i < list.size(); i++) {
+      values[list[i]]    = out[i];
+      evaluated[list[i]] = 1;
+    }
+  };
+  evaluateIndices(indices);
+
+  float scale = 0.0;
+  for (int i : indices) scale = std::max(scale, std::abs(values[i]));
+
+  std::vector<std::pair<int, int>> intervals, next;
+  for (size_t i = 1; i < indices.size(); i++)
+    if (indices[i] - indices[i - 1] > 1) intervals.push_back({indices[i - 1], indices[i]});
+
+  std::vector<int> mids;
+  while (!intervals.empty()) {
+    mids.clear();
+    for (const std::pair<int, int>& interval : intervals) mids.push_back((interval.first + interval.second) / 2);
+    evaluateIndices(mids);
+    for (int m : mids) scale = std::max(scale, std::abs(values[m]));
+
+    next.clear();
+    for (size_t i = 0; i < intervals.size(); i++) {
+      int   a = intervals[i].first, b = intervals[i].second, m = mids[i];
+      float f = (grid[m] - grid[a]) / (grid[b] - grid[a]);
+      float e = std::abs(values[m] - (values[a] + (values[b] - values[a]) * f));
+      if (e <= evaluate.p.plotting_adaptive * scale) continue;
+      if (m - a > 1) next.push_back({a, m});
+      if (b - m > 1) next.push_back({m, b});
+    }
+    std::swap(intervals, next);
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (!evaluated[i]) continue;
+    res.x.push_back(grid[i]);
+    res.y.push_back(values[i]);
+  }
+}
+
+PlotResult plot(experiment_t func, const SimulationParams& p) {
+  float dy    = pow(10.0, -p.plotting_resolution);
+  int   count = std::max(p.plotting_count, 0);
+
+  float              current = -dy * count / 2;
+  std::vector<float> grid;
+  for (int i = 0; i < count; i++) {
+    grid.push_back(current);
+    current += dy;
+  }
+
+  // Els experiments coneguts passen pel kernel vectorial (o pel camp llunyà en mode fasorial si el nombre de
+  // Fresnel ho permet, o per l'avaluació jeràrquica amb plotting_tree focus o més), els registrats pel kernel
+  // especialitzat pels flags actuals i la resta per integrate(). Sense focus no hi ha fasors per sumar: en mode
+  // fasorial aquests dos últims calculen la mitjana mostrejada i res.mode ho indica
+  PlotEvaluator evaluate{p};
+  evaluate.func                  = func;
+  evaluate.x                     = p.plotting_distance;
+  evaluate.sources               = experimentSources(func, p);
+  evaluate.groups                = experimentGroups(func, p);
+  const ExperimentKernel* kernel = findExperimentKernel(func);
+  evaluate.special               = kernel ? kernel->integrate[kernelMode(p)] : nullptr;
+
+  PlotResult res;
+  if (!evaluate.groups.empty()) res.fresnel = fresnelNumber(evaluate.groups, p);
+  if (evaluate.sources.empty()) res.path = evaluate.special ? PLOT_PATH_KERNEL : PLOT_PATH_SCALAR;
+  else if (p.INTEGRATION_MODE != INTEGRATION_PHASOR) res.path = PLOT_PATH_SAMPLED;
+  else if (res.fresnel < p.plotting_fresnel) res.path = PLOT_PATH_FARFIELD;
+  else if (p.plotting_tree > 0 && int(evaluate.sources.size()) >= p.plotting_tree) res.path = PLOT_PATH_TREE;
+  else res.path = PLOT_PATH_PHASOR;
+  evaluate.path = res.path;
+  res.mode      = evaluate.sources.empty() ? INTEGRATION_SAMPLED : p.INTEGRATION_MODE;
+
+  // Les taules de l'avaluació jeràrquica cobreixen tota la graella i es fan un sol cop, també pels nivells del
+  // mostreig adaptatiu (count és el màxim de punts que s'hi avaluen)
+  if (res.path == PLOT_PATH_TREE && count > 0) evaluate.tree = buildSourceTree(evaluate.x, grid.front(), grid.back(), count, evaluate.sources, p);
+
+  // La taula de geometria és per la graella sencera: el mostreig adaptatiu avalua subconjunts i calcula les
+  // distàncies sobre la marxa, com els plots que no caben a plotting_geometry_mb
+  if (p.plotting_adaptive > 0.0 && count > 2) {
+    plotAdaptive(evaluate, grid, res);
+  } else {
+    if (res.path == PLOT_PATH_SAMPLED || res.path == PLOT_PATH_PHASOR)
+      evaluate.geometry = cachedGeometryTable(evaluate.x, grid, evaluate.sources, size_t(std::max(p.plotting_geometry_mb, 0)) << 20);
+    res.x = std::move(grid);
+    res.y.resize(count);
+    evaluate.parallel(res.x.data(), count, res.y.data());
+  }
+  return res;
+}
+
+
+// Funció utiltaria per trobar els màxims de una funció utiltzant una finestra de convolució (peaks.hpp)
+std::vector<int> findLocalMaximumValues(std::vector<float>& data, const SimulationParams& p) {
+  std::vector<int> indices;
+  PeakDetector     detector(p.plot_highpassWindow);
+  detector.push(data.data(), data.size(), indices);
+  return indices;
+}
+} // namespace fdm
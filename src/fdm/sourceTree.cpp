@@ -0,0 +1,364 @@
+#include <fdm.hpp>
+#include <simd.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace fdm {
+
+#define TREE_TAPS        8          /* Punts de la interpolació de Lagrange de les taules (grau 7) */
+#define TREE_TAP_ERROR   1.07e-3    /* max |prod(t - t_i)| / 8! entre els dos nodes centrals */
+#define TREE_FLOAT_ERROR 2.4e-7     /* Error relatiu de la distància en float, la fase en float erra k * h * això */
+#define TREE_PAIR_COST   4.0        /* Cost d'una parella mostra-clúster (fase en double i interpolació) en focus */
+#define TREE_MAX_SAMPLES (16 << 20) /* Mostres màximes de les taules d'un nivell, 12 bytes per mostra */
+#define TREE_CHUNK       64         /* Punts per bloc de treball de l'avaluació final */
+
+// Focus consecutius (ordenats per desplaçament) d'un nivell de l'arbre
+struct TreeCluster {
+  int    begin, end;
+  double center;
+  double half; /* Semiamplada */
+};
+
+/* Cada clúster guarda G(y) = sum a_j e^{ik (r_j - R)} i D(y) = sum a_j mostrejats a la línia de la pantalla, amb R la
+ * distància al centre del clúster. La fase de G varia com a molt k * half / x per metre de y, per tant amb un pas
+ * de PI / (sigma * k * half / x) la interpolació de Lagrange de TREE_TAPS punts té un error relatiu inferior a
+ * TREE_TAP_ERROR * (PI / sigma)^TREE_TAPS. Els passos de tots els nivells són x / 16 dividit per potències de 2 i les
+ * graelles comencen a margin mostres abans del primer punt, per tant cada mostra d'un pare cau sempre a la mateixa
+ * fracció de la graella del fill i la interpolació és un filtre fix */
+struct TreeLevel {
+  std::vector<TreeCluster> clusters;
+  double                   half    = 0.0; /* Semiamplada més gran */
+  int                      shift   = 0;   /* Pas = x / 16 / 2^shift */
+  int                      margin  = 0;   /* Mostres abans del primer punt */
+  int                      samples = 0;   /* Mostres per clúster, múltiple de simd::vfloat::width */
+  double                   dy = 0.0, y0 = 0.0;
+  std::vector<float>       re, im, dc; /* [clúster][mostra] */
+};
+
+// Geometria i constants compartides per tots els nivells
+struct TreeContext {
+  double                        x, k, decay;
+  bool                          decayEnabled;
+  std::vector<ExperimentSource> sources; /* Ordenats per desplaçament */
+};
+
+// Nivell escollit, a punt per avaluar a qualsevol punt entre els yMin i yMax de buildSourceTree()
+struct SourceTree {
+  TreeContext         context;
+  int                 columns = 0; /* Clústers arrodonits a simd::vfloat::width */
+  double              y0 = 0.0, dy = 0.0;
+  double              reference = 0.0; /* Centre de tots els focus */
+  std::vector<float>  re, im, dc;      /* re i im [mostra][clúster], dc sumat sobre els clústers */
+  std::vector<double> centers;
+};
+
+static inline double treeDistance(const TreeContext& tree, double y) { return std::sqrt(tree.x * tree.x + y * y); }
+
+// k * distance reduït a [-PI, PI). Les distàncies en double tenen prou precisió per restar-les directament
+static inline float treePhase(const TreeContext& tree, double distance) {
+  double phase = tree.k * distance;
+  return phase - std::floor(phase * (0.5 / M_PI) + 0.5) * (2.0 * M_PI);
+}
+
+// Pes de Lagrange dels nodes -3..4 per la posició t (en mostres). Retorna el primer node
+static inline int lagrange(double t, float* weights) {
+  double base = std::floor(t);
+  double f    = t - base;
+  for (int i = 0; i < TREE_TAPS; i++) {
+    double w = 1.0;
+    for (int j = 0; j < TREE_TAPS; j++)
+      if (j != i) w *= (f - (j - TREE_TAPS / 2 + 1)) / double(i - j);
+    weights[i] = w;
+  }
+  return int(base) - TREE_TAPS / 2 + 1;
+}
+
+static void treeAllocate(TreeLevel& level) {
+  level.re.assign(size_t(level.samples) * level.clusters.size(), 0.0f);
+  level.im.assign(level.re.size(), 0.0f);
+  level.dc.assign(level.re.size(), 0.0f);
+}
+
+// Taules del nivell sumant directament els focus de cada clúster, en float i vectoritzat sobre les mostres com
+// integratePhasorBatch(). Només per clústers prou estrets perquè l'error de la fase en float càpiga a l'error
+static void treeDirect(const TreeContext& tree, TreeLevel& level) {
+  using simd::vfloat;
+  const int W = vfloat::width;
+  int       M = level.samples;
+  treeAllocate(level);
+
+  std::vector<float> grid(M);
+  for (int m = 0; m < M; m++) grid[m] = level.y0 + m * level.dy;
+
+  vfloat x2 = float(tree.x * tree.x), k = float(tree.k), decay = float(tree.decay);
+  workerPool().parallelFor(level.clusters.size(), 1, [&](int begin, int end) {
+    std::vector<float> Y(M), R(M);
+    for (int c = begin; c < end; c++) {
+      const TreeCluster& cluster = level.clusters[c];
+      float*             re      = level.re.data() + size_t(c) * M;
+      float*             im      = level.im.data() + size_t(c) * M;
+      float*             dc      = level.dc.data() + size_t(c) * M;
+      for (int m = 0; m < M; m++) {
+        Y[m] = grid[m] + float(cluster.center);
+        R[m] = std::sqrt(float(tree.x * tree.x) + Y[m] * Y[m]);
+      }
+      for (int j = cluster.begin; j < cluster.end; j++) {
+        vfloat s = float(tree.sources[j].offset - cluster.center), w = tree.sources[j].weight;
+        for (int m = 0; m < M; m += W) {
+          // r - R = s (Y + Yj) / (r + R), sense cancel·lació
+          vfloat Yc = vfloat::load(Y.data() + m), Yj = Yc + s;
+          vfloat r  = simd::sqrt(simd::fma(Yj, Yj, x2));
+          vfloat a  = tree.decayEnabled ? w * decay / r : w;
+          vfloat sn, cs;
+          simd::sincos(k * (s * (Yc + Yj) / (r + vfloat::load(R.data() + m))), sn, cs);
+          simd::fma(a, cs, vfloat::load(re + m)).store(re + m);
+          simd::fma(a, sn, vfloat::load(im + m)).store(im + m);
+          (a + vfloat::load(dc + m)).store(dc + m);
+        }
+      }
+    }
+  });
+}
+
+// Taules del nivell a partir de les dels dos fills, interpolades a la graella del pare i girades pel canvi de centre
+static void treeMerge(const TreeContext& tree, const TreeLevel& child, TreeLevel& level) {
+  using simd::vfloat;
+  const int W    = vfloat::width;
+  int       M    = level.samples;
+  int       step = 1 << (level.shift - child.shift);
+  treeAllocate(level);
+
+  // La mostra m del pare és a la posició child.margin + (m - level.margin) / step del fill: per cada residu r de
+  // (m - level.margin) mod step els pesos són els mateixos
+  std::vector<float> weights(size_t(step) * TREE_TAPS);
+  for (int r = 0; r < step; r++) lagrange(double(r) / step, weights.data() + size_t(r) * TREE_TAPS);
+
+  workerPool().parallelFor(level.clusters.size(), 1, [&](int begin, int end) {
+    std::vector<float>  gre(M), gim(M), gdc(M);
+    std::vector<double> R(M);
+    float               phase[W], vre[W], vim[W], vdc[W];
+    for (int c = begin; c < end; c++) {
+      const TreeCluster& cluster = level.clusters[c];
+      float*             re      = level.re.data() + size_t(c) * M;
+      float*             im      = level.im.data() + size_t(c) * M;
+      float*             dc      = level.dc.data() + size_t(c) * M;
+      for (int m = 0; m < M; m++) R[m] = treeDistance(tree, level.y0 + m * level.dy + cluster.center);
+
+      for (int f = 2 * c; f < std::min(2 * c + 2, int(child.clusters.size())); f++) {
+        const float* cre = child.re.data() + size_t(f) * child.samples;
+        const float* cim = child.im.data() + size_t(f) * child.samples;
+        const float* cdc = child.dc.data() + size_t(f) * child.samples;
+        std::fill(gre.begin(), gre.end(), 0.0f);
+        std::fill(gim.begin(), gim.end(), 0.0f);
+        std::fill(gdc.begin(), gdc.end(), 0.0f);
+
+        // Mostres m = level.margin + r + step * i, amb els nodes des de child.margin + i - 3 dins de la taula
+        for (int r = 0; r < step; r++) {
+          const float* w     = weights.data() + size_t(r) * TREE_TAPS;
+          int          first = std::max(TREE_TAPS / 2 - 1 - child.margin, -((level.margin + r) / step));
+          int          last  = std::min(child.samples - TREE_TAPS / 2 - 1 - child.margin, (M - 1 - level.margin - r) / step);
+          for (int i = first; i <= last; i += W) {
+            int q = child.margin + i - (TREE_TAPS / 2 - 1);
+            int n = std::min(W, last - i + 1);
+            if (n == W) {
+              vfloat sr = 0.0f, si = 0.0f, sd = 0.0f;
+              for (int t = 0; t < TREE_TAPS; t++) {
+                sr = simd::fma(w[t], vfloat::load(cre + q + t), sr);
+                si = simd::fma(w[t], vfloat::load(cim + q + t), si);
+                sd = simd::fma(w[t], vfloat::load(cdc + q + t), sd);
+              }
+              sr.store(vre);
+              si.store(vim);
+              sd.store(vdc);
+            } else {
+              for (int j = 0; j < n; j++) {
+                vre[j] = vim[j] = vdc[j] = 0.0f;
+                for (int t = 0; t < TREE_TAPS; t++) {
+                  vre[j] += w[t] * cre[q + j + t];
+                  vim[j] += w[t] * cim[q + j + t];
+                  vdc[j] += w[t] * cdc[q + j + t];
+                }
+              }
+            }
+            for (int j = 0; j < n; j++) {
+              int m  = level.margin + r + step * (i + j);
+              gre[m] = vre[j];
+              gim[m] = vim[j];
+              gdc[m] = vdc[j];
+            }
+          }
+        }
+
+        // G_pare += G_fill e^{ik (R_fill - R_pare)}
+        double center = child.clusters[f].center;
+        for (int m = 0; m < M; m += W) {
+          for (int j = 0; j < W; j++) phase[j] = treePhase(tree, treeDistance(tree, level.y0 + (m + j) * level.dy + center) - R[m + j]);
+          vfloat sn, cs, vr = vfloat::load(gre.data() + m), vi = vfloat::load(gim.data() + m);
+          simd::sincos(vfloat::load(phase), sn, cs);
+          (vfloat::load(re + m) + (vr * cs - vi * sn)).store(re + m);
+          (vfloat::load(im + m) + simd::fma(vr, sn, vi * cs)).store(im + m);
+          (vfloat::load(dc + m) + vfloat::load(gdc.data() + m)).store(dc + m);
+        }
+      }
+    }
+  });
+}
+
+// Taules del nivell transposades ([mostra][clúster]) per vectoritzar l'avaluació sobre els clústers, i D de tots
+// els clústers sumat
+static void treeTranspose(const TreeLevel& level, SourceTree& res) {
+  const int W = simd::vfloat::width;
+  int       M = level.samples;
+  int       C = (level.clusters.size() + W - 1) / W * W;
+
+  res.columns   = C;
+  res.y0        = level.y0;
+  res.dy        = level.dy;
+  res.reference = 0.5 * (res.context.sources.front().offset + res.context.sources.back().offset);
+  res.re.assign(size_t(M) * C, 0.0f);
+  res.im.assign(res.re.size(), 0.0f);
+  res.dc.assign(M, 0.0f);
+  res.centers.assign(C, 0.0);
+  for (size_t c = 0; c < level.clusters.size(); c++) {
+    res.centers[c] = level.clusters[c].center;
+    for (int m = 0; m < M; m++) {
+      res.re[size_t(m) * C + c] = level.re[size_t(c) * M + m];
+      res.im[size_t(m) * C + c] = level.im[size_t(c) * M + m];
+      res.dc[m] += level.dc[size_t(c) * M + m];
+    }
+  }
+}
+
+// Suma de les taules a cada punt amb la fase relativa al centre de tots els focus
+void evaluateSourceTree(const SourceTree& table, const float* y, int count, float* out) {
+  using simd::vfloat;
+  const int          W         = vfloat::width;
+  const TreeContext& tree      = table.context;
+  int                C         = table.columns;
+  const float*       re        = table.re.data();
+  const float*       im        = table.im.data();
+  const float*       dc        = table.dc.data();
+  const double*      centers   = table.centers.data();
+  double             reference = table.reference;
+
+  workerPool().parallelFor(count, TREE_CHUNK, [&](int begin, int end) {
+    float weights[TREE_TAPS], phase[W], sumRe[W], sumIm[W];
+    for (int i = begin; i < end; i++) {
+      int    b = lagrange((y[i] - table.y0) / table.dy, weights);
+      double R = treeDistance(tree, y[i] + reference);
+      float  d = 0.0;
+      for (int t = 0; t < TREE_TAPS; t++) d += weights[t] * dc[b + t];
+
+      vfloat accRe = 0.0f, accIm = 0.0f;
+      for (int c = 0; c < C; c += W) {
+        vfloat gr = 0.0f, gi = 0.0f;
+        for (int t = 0; t < TREE_TAPS; t++) {
+          gr = simd::fma(weights[t], vfloat::load(re + size_t(b + t) * C + c), gr);
+          gi = simd::fma(weights[t], vfloat::load(im + size_t(b + t) * C + c), gi);
+        }
+        for (int j = 0; j < W; j++) phase[j] = treePhase(tree, treeDistance(tree, y[i] + centers[c + j]) - R);
+        vfloat sn, cs;
+        simd::sincos(vfloat::load(phase), sn, cs);
+        accRe = accRe + (gr * cs - gi * sn);
+        accIm = accIm + simd::fma(gr, sn, gi * cs);
+      }
+      accRe.store(sumRe);
+      accIm.store(sumIm);
+      float fr = 0.0, fi = 0.0;
+      for (int j = 0; j < W; j++) {
+        fr += sumRe[j];
+        fi += sumIm[j];
+      }
+
+      // Mateixa expressió que integratePhasorBatch(): (sum a / 2)^2 + |sum a e^{ikr}|^2 / 8
+      out[i] = d * d * 0.25f + (fr * fr + fi * fi) * 0.125f;
+    }
+  });
+}
+
+std::shared_ptr<const SourceTree> buildSourceTree(float x, double yMin, double yMax, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p) {
+  const int W = simd::vfloat::width;
+  int       N = sources.size();
+  if (count <= 0 || N == 0 || x <= 0.0) return nullptr;
+
+  std::shared_ptr<SourceTree> res  = std::make_shared<SourceTree>();
+  TreeContext&                tree = res->context;
+  tree.x            = x;
+  tree.k            = 2.0 * M_PI / double(p.uLambda);
+  tree.decay        = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+  tree.decayEnabled = p.LIGHT_DECAY_ENABLED;
+  tree.sources      = sources;
+  std::sort(tree.sources.begin(), tree.sources.end(), [](const ExperimentSource& a, const ExperimentSource& b) { return a.offset < b.offset; });
+
+  // L'error es reparteix entre tots els nivells, i sigma és el sobremostreig que el compleix
+  int depth = 1;
+  while ((1 << (depth - 1)) < N) depth++;
+  double budget = std::max(double(p.plotting_tree_error), 1e-12) / depth;
+  double sigma  = std::max(M_PI / std::pow(budget / TREE_TAP_ERROR, 1.0 / TREE_TAPS), 2.0);
+
+  // Nivell l: clústers de 2^l focus consecutius
+  std::vector<TreeLevel> levels(depth);
+  for (int l = 0; l < depth; l++) {
+    TreeLevel& level = levels[l];
+    for (int begin = 0; begin < N; begin += 1 << l) {
+      int    end = std::min(begin + (1 << l), N);
+      double lo = tree.sources[begin].offset, hi = tree.sources[end - 1].offset;
+      level.clusters.push_back({begin, end, 0.5 * (lo + hi), 0.5 * (hi - lo)});
+      level.half = std::max(level.half, 0.5 * (hi - lo));
+    }
+    double required = M_PI * x / (sigma * tree.k * level.half);
+    while (level.shift < 40 && std::ldexp(x / 16.0, -level.shift) > required) level.shift++;
+    level.dy      = std::ldexp(x / 16.0, -level.shift);
+    level.samples = int(std::min((yMax - yMin) / level.dy, double(TREE_MAX_SAMPLES))) + 4 * TREE_TAPS;
+  }
+
+  // Cost de tenir les taules de cada nivell (directes o fusionant el nivell anterior) més el d'avaluar-les als
+  // punts, en avaluacions d'un focus. Es fa servir el nivell més barat si ho és més que la suma directa
+  std::vector<double> cost(depth);
+  std::vector<char>   direct(depth);
+  double              best   = double(count) * N;
+  int                 chosen = -1;
+  for (int l = 0; l < depth; l++) {
+    double samples = double(levels[l].samples);
+    double merge   = l > 0 ? cost[l - 1] + samples * levels[l - 1].clusters.size() * TREE_PAIR_COST : INFINITY;
+    double own     = l == 0 || tree.k * levels[l].half * TREE_FLOAT_ERROR <= budget ? samples * N : INFINITY;
+    direct[l]      = own <= merge;
+    cost[l]        = samples * levels[l].clusters.size() > TREE_MAX_SAMPLES ? INFINITY : std::min(own, merge);
+    double total   = cost[l] + double(count) * levels[l].clusters.size() * TREE_PAIR_COST;
+    if (total < best) {
+      best   = total;
+      chosen = l;
+    }
+  }
+  if (chosen < 0) return nullptr;
+
+  // Cada nivell ha de cobrir els nodes que en fa servir el següent, començant per TREE_TAPS / 2 + 1 mostres del
+  // nivell avaluat al voltant dels punts
+  int first = chosen;
+  while (!direct[first]) first--;
+  double reach = 0.0;
+  for (int l = chosen; l >= first; l--) {
+    TreeLevel& level = levels[l];
+    reach += (TREE_TAPS / 2 + 1) * level.dy;
+    level.margin  = int(std::ceil(reach / level.dy));
+    level.y0      = yMin - level.margin * level.dy;
+    level.samples = (int(std::ceil((yMax - yMin) / level.dy)) + 2 * level.margin + W) / W * W;
+  }
+
+  treeDirect(tree, levels[first]);
+  for (int l = first + 1; l <= chosen; l++) {
+    treeMerge(tree, levels[l - 1], levels[l]);
+    levels[l - 1] = TreeLevel();
+  }
+  treeTranspose(levels[chosen], *res);
+  return res;
+}
+
+void integrateTreeBatch(float x, const float* y, int count, const std::vector<ExperimentSource>& sources, const SimulationParams& p, float* out) {
+  if (count <= 0) return;
+  std::shared_ptr<const SourceTree> tree = buildSourceTree(x, *std::min_element(y, y + count), *std::max_element(y, y + count), count, sources, p);
+  if (tree) evaluateSourceTree(*tree, y, count, out);
+  else integratePhasorBatch(x, y, count, sources, p, out);
+}
+} // namespace fdm
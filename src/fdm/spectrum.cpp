@@ -0,0 +1,253 @@
+#include <spectrum.hpp>
+#include <simd.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace fdm {
+
+#define SPECTRUM_MIN   380e-9 /* Rang visible de les funcions CIE */
+#define SPECTRUM_MAX   780e-9
+#define SPECTRUM_FLOOR 1e-3 /* Potència relativa per sota de la qual no es mostreja */
+#define SPECTRAL_CHUNK 64   /* Punts per bloc de treball de spectralPlot() */
+
+Spectrum blackbodySpectrum(float temperature) {
+  const double h = 6.62607015e-34, c = 299792458.0, kB = 1.380649e-23;
+  Spectrum     spectrum;
+  for (int nm = 380; nm <= 780; nm += 5) {
+    double lambda = nm * 1e-9;
+    spectrum.lambda.push_back(lambda);
+    spectrum.power.push_back(1.0 / (std::pow(lambda / SPECTRUM_MIN, 5.0) * std::expm1(h * c / (lambda * kB * std::max(temperature, 1.0f)))));
+  }
+  return spectrum;
+}
+
+Spectrum gaussianSpectrum(float center, float fwhm) {
+  double   sigma = std::max(fwhm, 1e-12f) / (2.0 * std::sqrt(2.0 * std::log(2.0)));
+  Spectrum spectrum;
+  for (int i = -40; i <= 40; i++) {
+    double lambda = center + i * sigma * 0.1;
+    if (lambda <= 0.0) continue;
+    spectrum.lambda.push_back(lambda);
+    spectrum.power.push_back(std::exp(-0.5 * (i * 0.1) * (i * 0.1)));
+  }
+  return spectrum;
+}
+
+bool spectrumParse(const char* spec, Spectrum& spectrum) {
+  char* end;
+  if (strncmp(spec, "blackbody:", 10) == 0) {
+    float temperature = strtof(spec + 10, &end);
+    if (end == spec + 10 || *end != 0 || temperature <= 0.0) return false;
+    spectrum = blackbodySpectrum(temperature);
+    return true;
+  }
+  if (strncmp(spec, "led:", 4) == 0) {
+    float center = strtof(spec + 4, &end);
+    if (end == spec + 4 || *end != ':') return false;
+    const char* begin = end + 1;
+    float       fwhm  = strtof(begin, &end);
+    if (end == begin || *end != 0 || center <= 0.0 || fwhm <= 0.0) return false;
+    spectrum = gaussianSpectrum(center * 1e-9, fwhm * 1e-9);
+    return true;
+  }
+
+  FILE* file = fopen(spec, "r");
+  if (!file) return false;
+  spectrum = Spectrum();
+  char line[256];
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    if (line[strspn(line, " \t\r\n")] == '#' || line[strspn(line, " \t\r\n")] == 0) continue;
+    float nm, power;
+    ok = sscanf(line, "%f %f", &nm, &power) == 2 && nm > 0.0 && (spectrum.lambda.empty() || nm * 1e-9f > spectrum.lambda.back());
+    spectrum.lambda.push_back(nm * 1e-9f);
+    spectrum.power.push_back(power);
+  }
+  fclose(file);
+  return ok && !spectrum.lambda.empty();
+}
+
+float spectrumPower(const Spectrum& spectrum, float lambda) {
+  const std::vector<float>& l = spectrum.lambda;
+  if (l.empty() || lambda < l.front() || lambda > l.back()) return 0.0;
+  if (l.size() == 1) return spectrum.power[0];
+  int   i = std::min(int(std::upper_bound(l.begin(), l.end(), lambda) - l.begin()), int(l.size()) - 1);
+  float f = (lambda - l[i - 1]) / (l[i] - l[i - 1]);
+  return spectrum.power[i - 1] + (spectrum.power[i] - spectrum.power[i - 1]) * f;
+}
+
+// Ajust de les funcions CIE 1931 amb gaussianes de dues amplades (Wyman, Sloan i Shirley, 2013), lambda en nm
+static double cieLobe(double lambda, double mu, double sigma1, double sigma2) {
+  double t = (lambda - mu) / (lambda < mu ? sigma1 : sigma2);
+  return std::exp(-0.5 * t * t);
+}
+
+static void cieXyz(double lambda, double xyz[3]) {
+  xyz[0] = 1.056 * cieLobe(lambda, 599.8, 37.9, 31.0) + 0.362 * cieLobe(lambda, 442.0, 16.0, 26.7) - 0.065 * cieLobe(lambda, 501.1, 20.4, 26.2);
+  xyz[1] = 0.821 * cieLobe(lambda, 568.8, 46.9, 40.5) + 0.286 * cieLobe(lambda, 530.9, 16.3, 31.1);
+  xyz[2] = 1.217 * cieLobe(lambda, 437.0, 11.8, 36.0) + 0.681 * cieLobe(lambda, 459.0, 26.0, 13.8);
+}
+
+SpectralTable spectralTable(const Spectrum& spectrum, int samples) {
+  const int     W = simd::vfloat::width;
+  SpectralTable table;
+  samples = std::max(samples, 1);
+
+  // Només es mostreja on la font té potència dins del visible
+  float peak = 0.0;
+  for (float power : spectrum.power) peak = std::max(peak, power);
+  double lambdaMin = SPECTRUM_MAX, lambdaMax = SPECTRUM_MIN;
+  for (size_t i = 0; i < spectrum.lambda.size(); i++) {
+    if (spectrum.power[i] <= peak * SPECTRUM_FLOOR) continue;
+    lambdaMin = std::min(lambdaMin, std::max(double(spectrum.lambda[i]), SPECTRUM_MIN));
+    lambdaMax = std::max(lambdaMax, std::min(double(spectrum.lambda[i]), SPECTRUM_MAX));
+  }
+  if (lambdaMin > lambdaMax) return table;
+
+  double kMin   = 2.0 * M_PI / lambdaMax;
+  double kMax   = 2.0 * M_PI / lambdaMin;
+  double dk     = (kMax - kMin) / samples;
+  table.k0      = kMin + 0.5 * dk;
+  table.dk      = dk;
+  table.samples = (samples + W - 1) / W * W;
+  for (std::vector<float>& weight : table.weight) weight.assign(table.samples, 0.0f);
+
+  // XYZ -> sRGB lineal (D65). dlambda = lambda^2 / 2PI dk
+  static const double rgb[3][3] = {{3.2406, -1.5372, -0.4986}, {-0.9689, 1.8758, 0.0415}, {0.0557, -0.2040, 1.0570}};
+  double              total[3]  = {0.0, 0.0, 0.0};
+  for (int m = 0; m < samples; m++) {
+    double lambda = 2.0 * M_PI / (table.k0 + m * dk);
+    double xyz[3];
+    cieXyz(lambda * 1e9, xyz);
+    double power = spectrumPower(spectrum, lambda) * lambda * lambda;
+    for (int c = 0; c < 3; c++) {
+      double value       = power * (rgb[c][0] * xyz[0] + rgb[c][1] * xyz[1] + rgb[c][2] * xyz[2]);
+      table.weight[c][m] = value;
+      total[c] += value;
+    }
+  }
+
+  double scale = std::max(std::max(total[0], total[1]), total[2]);
+  if (scale <= 0.0) return table;
+  for (std::vector<float>& weight : table.weight)
+    for (float& w : weight) w /= scale;
+  return table;
+}
+
+template <class P>
+static void spectralIntensityP(const SpectralTable& table, const float* d, const float* amp, int points, int sources, float* rgb) {
+  using simd::vfloat;
+  const int W      = vfloat::width;
+  const int blocks = table.samples / W;
+
+  float lanes[W];
+  for (int m = 0; m < W; m++) lanes[m] = m * table.dk;
+  vfloat kLanes = vfloat::load(lanes) + table.k0;
+  float  kStep  = W * table.dk;
+
+  std::vector<vfloat> re(blocks), im(blocks);
+  std::vector<float>  stepCos(sources + W), stepSin(sources + W), padded(sources + W, 0.0f);
+  for (int i = 0; i < points; i++) {
+    const float* di = d + size_t(i) * sources;
+    const float* ai = amp + size_t(i) * sources;
+
+    // Gir d'un bloc de mostres a l'altre, e^{i kStep d_j}, vectoritzat sobre els focus
+    std::copy(di, di + sources, padded.begin());
+    for (int j = 0; j < sources; j += W) {
+      vfloat s, c;
+      simd::sincos<P>(vfloat::load(padded.data() + j) * kStep, s, c);
+      s.store(stepSin.data() + j);
+      c.store(stepCos.data() + j);
+    }
+
+    std::fill(re.begin(), re.end(), vfloat(0.0f));
+    std::fill(im.begin(), im.end(), vfloat(0.0f));
+    for (int j = 0; j < sources; j++) {
+      vfloat s, c;
+      simd::sincos<P>(kLanes * di[j], s, c);
+      vfloat a  = ai[j];
+      vfloat sw = stepSin[j], cw = stepCos[j];
+      for (int b = 0; b < blocks; b++) {
+        re[b]     = simd::fma(a, c, re[b]);
+        im[b]     = simd::fma(a, s, im[b]);
+        vfloat cn = c * cw - s * sw;
+        s         = simd::fma(s, cw, c * sw);
+        c         = cn;
+      }
+    }
+
+    vfloat sum[3] = {0.0f, 0.0f, 0.0f};
+    for (int b = 0; b < blocks; b++) {
+      vfloat intensity = simd::fma(re[b], re[b], im[b] * im[b]);
+      for (int ch = 0; ch < 3; ch++) sum[ch] = simd::fma(vfloat::load(table.weight[ch].data() + b * W), intensity, sum[ch]);
+    }
+    for (int ch = 0; ch < 3; ch++) {
+      sum[ch].store(lanes);
+      float total = 0.0;
+      for (int m = 0; m < W; m++) total += lanes[m];
+      rgb[3 * i + ch] = total;
+    }
+  }
+}
+
+void spectralIntensity(const SpectralTable& table, const float* d, const float* amp, int points, int sources, int precision, float* rgb) {
+  switch (precision) {
+    case PRECISION_MEDIUM: spectralIntensityP<simd::PrecisionMedium>(table, d, amp, points, sources, rgb); break;
+    case PRECISION_LOW: spectralIntensityP<simd::PrecisionLow>(table, d, amp, points, sources, rgb); break;
+    default: spectralIntensityP<simd::PrecisionFull>(table, d, amp, points, sources, rgb);
+  }
+}
+
+SpectralPlot spectralPlot(experiment_t func, const SpectralTable& table, const SimulationParams& p) {
+  float dy    = pow(10.0, -p.plotting_resolution);
+  int   count = std::max(p.plotting_count, 0);
+
+  SpectralPlot res;
+  float        current = -dy * count / 2;
+  for (int i = 0; i < count; i++) {
+    res.x.push_back(current);
+    current += dy;
+  }
+  res.rgb.assign(size_t(count) * 3, 0.0f);
+
+  std::vector<ExperimentSource> sources = experimentSources(func, p);
+  if (sources.empty() || table.samples == 0) return res;
+
+  // El terme constant (sum a / 2)^2 no depèn de k, es multiplica per la suma dels pesos
+  float total[3] = {0.0, 0.0, 0.0};
+  for (int c = 0; c < 3; c++)
+    for (float w : table.weight[c]) total[c] += w;
+
+  int   n     = sources.size();
+  float x     = p.plotting_distance;
+  float decay = pow(0.1, p.LIGHT_DECAY_EXPONENT);
+  workerPool().parallelFor(count, SPECTRAL_CHUNK, [&](int begin, int end) {
+    std::vector<float> d(size_t(end - begin) * n), amp(d.size()), dc(end - begin);
+    for (int i = begin; i < end; i++) {
+      float  y  = res.x[i];
+      float  r0 = std::sqrt(x * x + y * y);
+      float* di = d.data() + size_t(i - begin) * n;
+      float* ai = amp.data() + size_t(i - begin) * n;
+      float  a0 = 0.0;
+      for (int j = 0; j < n; j++) {
+        float o = sources[j].offset;
+        float r = std::sqrt(x * x + (y + o) * (y + o));
+        di[j]   = o * (2.0f * y + o) / (r + r0);
+        ai[j]   = p.LIGHT_DECAY_ENABLED ? sources[j].weight * decay / r : sources[j].weight;
+        a0 += ai[j];
+      }
+      dc[i - begin] = a0 * 0.5f;
+    }
+
+    float* out = res.rgb.data() + size_t(begin) * 3;
+    spectralIntensity(table, d.data(), amp.data(), end - begin, n, p.KERNEL_PRECISION, out);
+    for (int i = 0; i < end - begin; i++)
+      for (int c = 0; c < 3; c++) out[3 * i + c] = out[3 * i + c] * 0.125f + dc[i] * dc[i] * total[c];
+  });
+  return res;
+}
+} // namespace fdm
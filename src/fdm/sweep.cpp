@@ -0,0 +1,112 @@
+#include <sweep.hpp>
+#include <orderedWriter.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace fdm {
+
+struct SweepParameter {
+  const char*              name;
+  float SimulationParams::*value;
+  int SimulationParams::*  intValue;
+};
+
+static SweepParameter parameters[] = {
+  {"lambda", &SimulationParams::uLambda, nullptr},
+  {"n", nullptr, &SimulationParams::NCOUNT},
+  {"distance", &SimulationParams::plotting_distance, nullptr},
+  {"amplada", &SimulationParams::uAmpladaMul, nullptr},
+  {"steps", nullptr, &SimulationParams::INTEGRATION_STEPS},
+  {"decay-exponent", &SimulationParams::LIGHT_DECAY_EXPONENT, nullptr},
+  {"resolution", &SimulationParams::plotting_resolution, nullptr},
+};
+
+static SweepParameter* findParameter(const std::string& name) {
+  for (SweepParameter& parameter : parameters)
+    if (name == parameter.name) return &parameter;
+  return nullptr;
+}
+
+bool sweepParameter(SimulationParams& p, const std::string& name, float value) {
+  SweepParameter* parameter = findParameter(name);
+  if (!parameter) return false;
+  if (parameter->value) p.*parameter->value = value;
+  else p.*parameter->intValue = std::lround(value);
+  return true;
+}
+
+bool sweepAxisParse(const char* spec, SweepAxis& axis) {
+  const char* equal = strchr(spec, '=');
+  if (!equal) return false;
+  axis.name = std::string(spec, equal);
+  axis.values.clear();
+  if (!findParameter(axis.name)) return false;
+
+  char* end;
+  float start = strtof(equal + 1, &end);
+  if (end == equal + 1) return false;
+
+  if (*end == ':') {
+    float stop  = strtof(end + 1, &end);
+    int   count = *end == ':' ? strtol(end + 1, &end, 10) : 0;
+    if (*end != 0 || count <= 0) return false;
+    for (int i = 0; i < count; i++) axis.values.push_back(count == 1 ? start : start + (stop - start) * i / (count - 1));
+    return true;
+  }
+
+  axis.values.push_back(start);
+  while (*end == ',') {
+    const char* begin = end + 1;
+    axis.values.push_back(strtof(begin, &end));
+    if (end == begin) return false;
+  }
+  return *end == 0;
+}
+
+int sweepSize(const std::vector<SweepAxis>& axes) {
+  int size = 1;
+  for (const SweepAxis& axis : axes) size *= axis.values.size();
+  return size;
+}
+
+void runSweep(experiment_t func, const SimulationParams& params, const std::vector<SweepAxis>& axes, const SweepSink& sink, int queueSize) {
+  WorkerPool& pool = workerPool();
+  int         size = sweepSize(axes);
+
+  // El thread d'escriptura rep els perfils en ordre d'índex encara que s'acabin de calcular desordenats
+  OrderedWriter<SweepPoint> writer(sink, std::max(queueSize, pool.size()));
+
+  auto profile = [&](int index) {
+    SweepPoint point;
+    point.index = index;
+    point.values.resize(axes.size());
+
+    SimulationParams p    = params;
+    int              rest = index;
+    for (int a = axes.size() - 1; a >= 0; a--) {
+      point.values[a] = axes[a].values[rest % axes[a].values.size()];
+      rest /= axes[a].values.size();
+      sweepParameter(p, axes[a].name, point.values[a]);
+    }
+    point.analysis = analyzePlot(func, p);
+    writer.push(index, std::move(point));
+  };
+
+  // Amb almenys un perfil per thread cada thread del pool en calcula un sencer (el parallelFor de plot() es fa al
+  // mateix thread), fins a la finestra de perfils pendents d'escriure. Amb menys perfils cada un fa servir tot el pool
+  if (size >= pool.size()) {
+    pool.parallelFor(size, 1, [&](int begin, int end) {
+      for (int index = begin; index < end; index++) {
+        writer.wait(index);
+        profile(index);
+      }
+    });
+  } else {
+    for (int index = 0; index < size; index++) profile(index);
+  }
+  writer.finish();
+}
+} // namespace fdm
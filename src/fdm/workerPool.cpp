@@ -0,0 +1,116 @@
+#include <workerPool.hpp>
+#include <algorithm>
+
+namespace fdm {
+
+// Pool del bloc que executa aquest thread, per detectar les crides niuades a parallelFor() sense tornar a agafar busy
+static thread_local const WorkerPool* insideJob = nullptr;
+
+WorkerPool::WorkerPool(int threads) { resize(threads); }
+
+WorkerPool::~WorkerPool() { stop(); }
+
+void WorkerPool::resize(int threads) {
+  std::lock_guard<std::mutex> lock(busy);
+  if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  if (threads == size()) return;
+
+  stop();
+  // Els threads nous han de considerar vist el treball anterior: generation no torna a 0
+  unsigned current;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exiting = false;
+    current = generation;
+  }
+  for (int i = 0; i < threads - 1; i++) workers.emplace_back(&WorkerPool::workerLoop, this, current);
+}
+
+void WorkerPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exiting = true;
+  }
+  wake.notify_all();
+  for (std::thread& worker : workers) worker.join();
+  workers.clear();
+}
+
+void WorkerPool::runChunks(const std::function<void(int, int)>& job, int count, int chunk) {
+  const WorkerPool* outer = insideJob;
+  insideJob               = this;
+  int chunks              = (count + chunk - 1) / chunk;
+  for (int c = nextChunk++; c < chunks; c = nextChunk++) {
+    int begin = c * chunk;
+    job(begin, std::min(begin + chunk, count));
+  }
+  insideJob = outer;
+}
+
+void WorkerPool::workerLoop(unsigned seen) {
+  while (true) {
+    // El treball es copia amb el mutex agafat: parallelFor() el canvia per la generació següent
+    const std::function<void(int, int)>* current;
+    int                                  count, chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return exiting || generation != seen; });
+      if (exiting) return;
+      seen    = generation;
+      current = job;
+      count   = jobCount;
+      chunk   = jobChunk;
+    }
+
+    runChunks(*current, count, chunk);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--running == 0) done.notify_one();
+    }
+  }
+}
+
+void WorkerPool::parallelFor(int count, int chunk, const std::function<void(int, int)>& _job) {
+  if (count <= 0) return;
+  chunk = std::max(chunk, 1);
+
+  // Des d'un bloc d'aquest mateix pool (el thread ja té busy o és un worker) tot es fa aquí: try_lock sobre un mutex
+  // que el thread ja té no està definit
+  if (insideJob == this) {
+    _job(0, count);
+    return;
+  }
+
+  // Sense treball per repartir no cal despertar ningú, i si un altre thread ja fa servir els workers es fa aquí
+  std::unique_lock<std::mutex> owner(busy, std::try_to_lock);
+  if (!owner || workers.empty() || count <= chunk) {
+    // Sense busy el bloc pot fer servir els workers per les seves crides niuades
+    if (owner) owner.unlock();
+    _job(0, count);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    job       = &_job;
+    jobCount  = count;
+    jobChunk  = chunk;
+    nextChunk = 0;
+    running   = workers.size();
+    generation++;
+  }
+  wake.notify_all();
+
+  runChunks(_job, count, chunk);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return running == 0; });
+  job = nullptr;
+}
+
+WorkerPool& workerPool() {
+  static WorkerPool pool;
+  return pool;
+}
+} // namespace fdm
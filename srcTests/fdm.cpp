@@ -1,162 +1,18 @@
 #include "imgui.h"
 #include <video.hpp>
 #include <implot/implot.h>
+#include <fdm.hpp>
+#include <plotWorker.hpp>
+#include <raster.hpp>
+#include <spectrum.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 using namespace NextVideo;
+using namespace fdm;
 
 
-// CONSTANTS (es un poc caòtic)
-#define C                  299792458.0
-#define LIGHT_DECAY_FACTOR 1.0e-5
-#define GAMMA_CORRECTED    1.0
-#define A_WAVE             5000e-10
-#define A_SEPARATION       0.01e-3
-#define A_L                = 200.0e-3
-#define ZOOM               1e-4
-#define TIME_ZOOM          (1e-6 / C)
-#define N                  NCOUNT
-
-int   NCOUNT               = 5;       /* Nombre de focus virtuals en xarxa de difracció */
-int   INTEGRATION_STEPS    = 15;      /* Nombre de pasos de integració per calcular la mitjana */
-bool  LIGHT_DECAY_ENABLED  = false;   /* Activar divisió per distancia */
-float LIGHT_DECAY_EXPONENT = 0.00002; /* Correcció per exponent, per ajustar els valors a valors representables */
-float plotting_distance    = 200e-3;  /* Distancia de la pantalla */
-float plotting_resolution  = 4;       /* Resolució del plot */
-int   plotting_count       = 4000;    /* Cantitat de mostreig del plot */
-int   plot_highpassWindow  = 10;      /* Tamany de la finestra de cerca de màxims */
-
-#define B_SEPARATION 0.01e-3
-#define C_SEPARATION 0.001e-3
-
-
-/* CPU BACKEND */
-using namespace glm;
-
-float uLambda     = 5000e-10;
-float uAmpladaMul = C_SEPARATION;
-
-#define LAMBDA uLambda
-
-bool uAmpladaFixa;
-bool uNormalitzarXarxa;
-
-
-// FUNCIONS DE LA SIMULACIÖ
-// Aquest codi es el mateix que el de fdm.glsl, pero compilat directament en C++ per poder evaluar la gràfica en
-// punts concrets i treure el plot
-
-//Retorna el coeficient de distància amb la pantalla
-float lightValue(vec2 st) {
-  //Correcció per mostrar de forma dinàmica a la pantalla
-  return pow(0.1, LIGHT_DECAY_EXPONENT) / sqrt(st.x * st.x + st.y * st.y);
-}
-
-
-// Retorna el valor de la funció del camp elèctric en un temps t en una posició st del espai
-float light(vec2 st, float t) {
-  float l = length(vec3(st.x, st.y, 0));
-  float k = 2.0 * M_PI / LAMBDA;
-  float f = C / LAMBDA;
-  float w = f * 2.0 * M_PI;
-
-  float value = (sin(l * k - t * w) * 0.5 + 0.5);
-  if (LIGHT_DECAY_ENABLED) return value * lightValue(st);
-  return value;
-}
-
-
-float net(vec2 st, float off, float t, float separation) {
-  float result = 0.0;
-  if (uAmpladaFixa)
-    separation = separation / float(N);
-  float offset = -float(N) * separation * 0.5 + off;
-  for (int i = 0; i < N; i++) {
-    result += light(st + vec2(0, offset), t);
-    offset += separation;
-  }
-  if (uNormalitzarXarxa)
-    return result / float(N);
-  return result;
-}
-
-float experimentA(vec2 st, float t) {
-  return light(st + vec2(0.0, -A_SEPARATION * 0.5), t) * 0.5 + light(st + vec2(0.0, A_SEPARATION * 0.5), t) * 0.5;
-}
-float experimentB(vec2 st, float t) {
-  return net(st, 0.0, t, B_SEPARATION);
-}
-
-typedef float (*experiment_t)(vec2 st, float t);
-
-#define C_SEPARATION 0.001e-3
-
-float experimentC(vec2 st, float t) {
-  return net(st, 0.0, t, uAmpladaMul);
-}
-
-float experimentD(vec2 st, float t) {
-  float o = 0.1e-3;
-  return net(st, -o / 2.0, t, C_SEPARATION) * 0.5 + net(st, o / 2.0, t, C_SEPARATION) * 0.5;
-}
-
-float integrate(vec2 st, float tP, experiment_t func) {
-
-  float result = 0.0;
-  float f      = C / A_WAVE;
-  float w      = f * 2.0 * M_PI;
-  float L      = float(INTEGRATION_STEPS);
-  float dt     = 2.0 * M_PI / (L * w);
-  float t      = 0.0;
-  for (int i = 0; i < INTEGRATION_STEPS; i++) {
-    float partial = func(st, t + tP);
-    result += partial * partial;
-    t += dt;
-  }
-  return result / L;
-}
-
-
-// Funcions per trobar els valors del plot
-struct PlotResult {
-  std::vector<float> y;
-  std::vector<float> x;
-};
-
-PlotResult plot(experiment_t func) {
-  float x     = plotting_distance;
-  float dy    = pow(10.0, -plotting_resolution);
-  int   count = plotting_count;
-
-  float      current = -dy * count / 2;
-  PlotResult res;
-  for (int i = 0; i < count; i++) {
-    res.y.push_back(integrate(glm::vec2(x, current), 0.0, func));
-    res.x.push_back(current);
-    current += dy;
-  }
-  return res;
-}
-
-
-// Funció utiltaria per trobar els màxims de una funció utiltzant una finestra de convolució
-std::vector<int> findLocalMaximumValues(std::vector<float>& data) {
-  int              lookUpSize = plot_highpassWindow;
-  std::vector<int> indices;
-  if (data.size() < (lookUpSize * 2 + 1)) return {};
-
-  for (int i = lookUpSize; i < data.size() - lookUpSize - 1; i++) {
-    bool isMaxima = true;
-    for (int j = i - lookUpSize; j < i + lookUpSize; j++) {
-      if (data[j] > data[i]) {
-        isMaxima = false;
-        break;
-      }
-    }
-    if (isMaxima) indices.push_back(i);
-  }
-
-  return indices;
-}
-
 /* GL CODE */
 /* GL CALLBACKS*/
 void messageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
@@ -169,6 +25,7 @@ GLuint iTime;
 GLuint iZoom;
 GLuint iResolution;
 GLuint iIntegrationMode;
+GLuint iPhasorMode;
 GLuint iDecayMode;
 GLuint iDecayExponent;
 GLuint iExperimentSelector;
@@ -177,6 +34,12 @@ GLuint iN;
 GLuint iAmpladaFixa;
 GLuint iNormalitzarXarxa;
 GLuint iAmpladaMul;
+GLuint iAccumulate;
+GLuint iSampleOffset;
+GLuint iSampleCount;
+GLuint accumProgram;
+GLuint iAccum;
+GLuint iSamples;
 
 #define INITIAL_LAMBDA 5000e-10
 #define MIN_LAMBDA     3000
@@ -190,12 +53,36 @@ bool  uIntegration;
 
 bool experimentPractica = true;
 
-experiment_t currentExperiment() {
-  if (uExperiment == 0) return experimentA;
-  if (uExperiment == 1) return experimentB;
-  if (uExperiment == 2) return experimentC;
-  if (uExperiment >= 3) return experimentD;
-}
+// Còpia dels paràmetres que edita la interfície. Quan canvia es publica sencera (publishParams) i el plot es calcula
+// en segon pla amb la instantània publicada
+SimulationParams params;
+PlotWorker*      plotWorker;
+
+// Imatge de fdm.glsl calculada a la CPU de gruixut a fi (raster.hpp) en lloc del shader. Cada frame hi dedica com
+// a molt CPU_RENDER_BUDGET ms i la passada en curs es descarta quan canvia algun paràmetre
+#define CPU_RENDER_BUDGET 8.0
+bool              cpuRender        = false;
+GLuint            cpuTexture       = 0;
+int               cpuTextureWidth  = 0;
+int               cpuTextureHeight = 0;
+ProgressiveRaster cpuRaster;
+
+// Acumulació del mode integrat: cada frame suma accumSamplesPerFrame mostres temporals noves a accumTexture (R32F)
+// i es mostra la mitjana. Es torna a començar quan canvia algun uniform, i després de ACCUM_MAX_SAMPLES mostres
+// només es mostra
+#define ACCUM_MAX_SAMPLES     1024
+#define ACCUM_CHECK_TOLERANCE 1e-3 /* Error màxim de --accumulation-check, relatiu al màxim de la imatge */
+bool       uAccumulate          = false;
+int        accumSamplesPerFrame = 1;
+int        accumSamples         = 0;
+int        accumWidth           = 0;
+int        accumHeight          = 0;
+GLuint     accumFbo             = 0;
+GLuint     accumTexture         = 0;
+uint64_t   accumKey             = 0;
+RasterView accumView;
+
+experiment_t currentExperiment() { return experimentSelect(uExperiment); }
 
 void init() {
   program             = glUtilLoadProgram("assets/filter.vs", "assets/fdm.glsl");
@@ -203,6 +90,7 @@ void init() {
   iZoom               = glGetUniformLocation(program, "iZoom");
   iResolution         = glGetUniformLocation(program, "iResolution");
   iIntegrationMode    = glGetUniformLocation(program, "iIntegrationMode");
+  iPhasorMode         = glGetUniformLocation(program, "iPhasorMode");
   iDecayMode          = glGetUniformLocation(program, "iDecayMode");
   iDecayExponent      = glGetUniformLocation(program, "iDecayExponent");
   iExperimentSelector = glGetUniformLocation(program, "iExperimentSelector");
@@ -212,43 +100,87 @@ void init() {
   iNormalitzarXarxa   = glGetUniformLocation(program, "iNormalitzarXarxa");
   iLambda             = glGetUniformLocation(program, "iLambda");
   iAmpladaMul         = glGetUniformLocation(program, "iAmpladaMul");
+  iAccumulate         = glGetUniformLocation(program, "iAccumulate");
+  iSampleOffset       = glGetUniformLocation(program, "iSampleOffset");
+  iSampleCount        = glGetUniformLocation(program, "iSampleCount");
+
+  accumProgram = glUtilLoadProgram("assets/filter.vs", "assets/fdmAccum.glsl");
+  iAccum       = glGetUniformLocation(accumProgram, "iAccum");
+  iSamples     = glGetUniformLocation(accumProgram, "iSamples");
 }
 
 NextVideo::ISurface* surface;
 
+// Uniforms del shader que no són a params, com a RasterView per comparar-los i pel raster de CPU
+RasterView currentView() {
+  RasterView view;
+  view.width       = surface->getWidth();
+  view.height      = surface->getHeight();
+  view.zoom        = uZoom;
+  view.time        = uTime;
+  view.distance    = uDistance;
+  view.experiment  = uExperiment;
+  view.integration = uIntegration;
+  return view;
+}
+
 
 void uiRender() {
+  if (cpuRender && cpuTexture) ImGui::GetBackgroundDrawList()->AddImage((ImTextureID)(intptr_t)cpuTexture, ImVec2(0, 0), ImVec2(cpuTextureWidth, cpuTextureHeight));
+
   if (ImGui::Begin("Simulation parameters")) {
     ImGui::Text("Simulation types");
     ImGui::Checkbox("Lab Experiments", &experimentPractica);
 
     ImGui::Separator();
     ImGui::Text("Simulation parameters");
-    ImGui::Checkbox("Use light decay", &LIGHT_DECAY_ENABLED);
+    ImGui::Checkbox("Use light decay", &params.LIGHT_DECAY_ENABLED);
     ImGui::Checkbox("Integration", &uIntegration);
-    ImGui::Checkbox("Amplada fixa", &uAmpladaFixa);
-    ImGui::Checkbox("Normalitzar xarxa", &uNormalitzarXarxa);
-    ImGui::SliderFloat("Light decay exponent", &LIGHT_DECAY_EXPONENT, 1.0, 10.0);
+    ImGui::Checkbox("Accumulate", &uAccumulate);
+    if (uAccumulate) {
+      ImGui::SameLine();
+      ImGui::Text("%d samples", accumSamples);
+      ImGui::InputInt("Samples per frame", &accumSamplesPerFrame);
+    }
+    ImGui::Combo("Integration mode", &params.INTEGRATION_MODE, "Sampled\0Phasor\0");
+    ImGui::Checkbox("Amplada fixa", &params.uAmpladaFixa);
+    ImGui::Checkbox("Normalitzar xarxa", &params.uNormalitzarXarxa);
+    ImGui::Checkbox("Precise phase", &params.PHASE_REFERENCE);
+    ImGui::Combo("Kernel precision", &params.KERNEL_PRECISION, "Full\0Medium (1e-6)\0Low (1e-4)\0");
+    ImGui::SliderFloat("Light decay exponent", &params.LIGHT_DECAY_EXPONENT, 1.0, 10.0);
     ImGui::SliderFloat("Zoom", &uZoom, 0.01, 50.0);
     static float AmpladaSlider = 1.0f;
     ImGui::SliderFloat("Amplada", &AmpladaSlider, 1.0, 10.0);
     ImGui::SliderFloat("Time", &uTime, 0.01, 10.0);
     static int lambdaSlider = 5000;
     ImGui::SliderInt("Light lambda", &lambdaSlider, 2000, 8000);
-    ImGui::SliderInt("N", &NCOUNT, 2, 50);
+    ImGui::SliderInt("N", &params.NCOUNT, 2, 50);
     ImGui::InputFloat("Distance", &uDistance);
+    ImGui::Checkbox("CPU render", &cpuRender);
+    if (cpuRender) {
+      ImGui::SameLine();
+      if (cpuRaster.done()) ImGui::Text("done");
+      else ImGui::Text("pass 1/%d", cpuRaster.stride());
+    }
 
     ImGui::Separator();
-    ImGui::InputFloat("Plot resolution", &plotting_resolution);
-    ImGui::InputInt("Plot count", &plotting_count);
-    ImGui::InputInt("Plot high pass winow", &plot_highpassWindow);
+    ImGui::InputFloat("Plot resolution", &params.plotting_resolution);
+    ImGui::InputInt("Plot count", &params.plotting_count);
+    ImGui::InputInt("Plot high pass winow", &params.plot_highpassWindow);
+    static int plotThreads = 0;
+    if (ImGui::InputInt("Plot threads", &plotThreads)) workerPool().resize(plotThreads);
+    ImGui::InputFloat("Plot far field Fresnel", &params.plotting_fresnel, 0.0f, 0.0f, "%.4f");
+    ImGui::InputFloat("Plot adaptive tolerance", &params.plotting_adaptive, 0.0f, 0.0f, "%.4f");
+    ImGui::InputInt("Plot geometry cache (MB)", &params.plotting_geometry_mb);
+    ImGui::InputInt("Plot tree from N", &params.plotting_tree);
+    ImGui::InputFloat("Plot tree error", &params.plotting_tree_error, 0.0f, 0.0f, "%.1e");
 
     ImGui::Separator();
-    ImGui::InputInt("Integration steps ", &INTEGRATION_STEPS);
+    ImGui::InputInt("Integration steps ", &params.INTEGRATION_STEPS);
     ImGui::End();
 
-    uLambda     = float(lambdaSlider) * 1e-10;
-    uAmpladaMul = AmpladaSlider * C_SEPARATION;
+    params.uLambda     = float(lambdaSlider) * 1e-10;
+    params.uAmpladaMul = AmpladaSlider * C_SEPARATION;
   }
 
 
@@ -261,29 +193,57 @@ void uiRender() {
     ImGui::Checkbox("Show integration plot", &showPlot);
 
     if (showPlot) {
-      ImGui::SliderFloat("Screen distance", &plotting_distance, 0.0, 1.0);
-      static bool currentPlot = 0;
-      auto        data        = plot(currentExperiment());
-
-      auto maximum = findLocalMaximumValues(data.y);
-
-      std::vector<float> xMaxData;
-      std::vector<float> yMaxData;
-
-      if (maximum.size() > 0) {
-        for (int i = 0; i < maximum.size(); i++) {
-          xMaxData.push_back(data.x[maximum[i]]);
-          yMaxData.push_back(data.y[maximum[i]]);
-        }
+      ImGui::SliderFloat("Screen distance", &params.plotting_distance, 0.0, 1.0);
+
+      // El plot i els màxims només es recalculen quan canvia algun paràmetre de la simulació, i mentrestant es
+      // mostra l'últim acabat
+      static uint64_t published = 0;
+      uint64_t        key       = plotKey(currentExperiment(), params);
+      if (key != published) {
+        publishParams(params);
+        published = key;
       }
-      std::vector<int> maximum2;
-      if (maximum.size() > 0) maximum2 = findLocalMaximumValues(yMaxData);
-
+      plotWorker->request(currentExperiment(), publishedParams());
+
+      static const PlotAnalysis           empty;
+      std::shared_ptr<const PlotAnalysis> result   = plotWorker->result();
+      const PlotAnalysis&                 analysis = result ? *result : empty;
+      const PlotResult&                   data     = analysis.data;
+      const std::vector<int>&   maximum  = analysis.maximum;
+      const std::vector<float>& xMaxData = analysis.xMax;
+      const std::vector<float>& yMaxData = analysis.yMax;
+      const std::vector<int>&   maximum2 = analysis.maximum2;
+      ImGui::Text("Plot path: %s (Fresnel %.3g), %d points%s%s", plotPathName(data.path), data.fresnel, int(data.x.size()),
+                  result && !plotWorker->busy() && params.INTEGRATION_MODE == INTEGRATION_PHASOR && data.mode != INTEGRATION_PHASOR ? ", sampled (no phasor variant)" : "", plotWorker->busy() ? ", computing..." : "");
 
       static bool normalizeData = false;
 
       ImGui::Checkbox("Normalize data", &normalizeData);
 
+      // Perfil RGB amb llum blanca d'un cos negre. Es calcula aquí mateix (uns ms) i només quan canvia algun paràmetre
+      static bool               spectral    = false;
+      static float              temperature = 6500.0;
+      static SpectralPlot       spectralData;
+      static std::vector<float> spectralChannel[3]; /* ImPlot fa servir el mateix stride per x i y */
+      ImGui::Checkbox("Spectral (white light)", &spectral);
+      if (spectral) {
+        ImGui::SameLine();
+        ImGui::SliderFloat("Source temperature (K)", &temperature, 1000.0, 12000.0);
+        static uint64_t spectralKey         = 0;
+        static float    spectralTemperature = 0.0;
+        if (key != spectralKey || temperature != spectralTemperature) {
+          spectralData = spectralPlot(currentExperiment(), spectralTable(blackbodySpectrum(temperature)), params);
+          for (int c = 0; c < 3; c++) {
+            spectralChannel[c].resize(spectralData.x.size());
+            for (int i = 0; i < spectralData.x.size(); i++) spectralChannel[c][i] = spectralData.rgb[3 * i + c];
+          }
+          spectralKey         = key;
+          spectralTemperature = temperature;
+        }
+      }
+
+      const float*              yData = data.y.data();
+      static std::vector<float> normalizedData;
       if (normalizeData) {
         float minVal = 10e50;
         float maxVal = -10e50;
@@ -297,13 +257,22 @@ void uiRender() {
         ImGui::Text("Max value %f\n", maxVal);
 
 
+        normalizedData.resize(data.y.size());
         for (int i = 0; i < data.y.size(); i++) {
-          data.y[i] = (data.y[i] - minVal) / (maxVal - minVal);
+          normalizedData[i] = (data.y[i] - minVal) / (maxVal - minVal);
         }
+        yData = normalizedData.data();
       }
 
       if (ImPlot::BeginPlot("FDM", "Distancia en X", "Intensitat llum", ImVec2(800, 400))) {
-        ImPlot::PlotLine("Integration", data.x.data(), data.y.data(), data.x.size());
+        ImPlot::PlotLine("Integration", data.x.data(), yData, data.x.size());
+        if (spectral) {
+          static const char* channels[] = {"Red", "Green", "Blue"};
+          for (int c = 0; c < 3; c++) {
+            ImPlot::SetNextLineStyle(ImVec4(c == 0, c == 1, c == 2, 1.0));
+            ImPlot::PlotLine(channels[c], spectralData.x.data(), spectralChannel[c].data(), spectralData.x.size());
+          }
+        }
 
         if (maximum.size() > 0) {
           ImPlot::PlotScatter("Local maxima", xMaxData.data(), yMaxData.data(), xMaxData.size());
@@ -341,31 +310,153 @@ void uiRender() {
     }
   }
 }
+// Avança la imatge progressiva i la puja sencera a la textura si ha canviat
+void renderCpu() {
+  cpuRaster.request(currentView(), params);
+  if (!cpuRaster.step(CPU_RENDER_BUDGET)) return;
+
+  const RasterImage& image = cpuRaster.image();
+  if (cpuTexture == 0) {
+    glGenTextures(1, &cpuTexture);
+    glBindTexture(GL_TEXTURE_2D, cpuTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // Escala de grisos, com color = vec3(result) al shader
+    GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+    glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+  }
+  glBindTexture(GL_TEXTURE_2D, cpuTexture);
+  if (image.width != cpuTextureWidth || image.height != cpuTextureHeight) {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, image.width, image.height, 0, GL_RED, GL_FLOAT, image.data.data());
+    cpuTextureWidth  = image.width;
+    cpuTextureHeight = image.height;
+  } else {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RED, GL_FLOAT, image.data.data());
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Suma les mostres noves al render target i el mostra dividit per les mostres acumulades. El programa del shader ja
+// té els uniforms del frame
+void renderAccumulated() {
+  RasterView view = currentView();
+  uint64_t   key  = plotKey(currentExperiment(), params);
+  if (view.width != accumWidth || view.height != accumHeight) {
+    if (accumFbo == 0) {
+      glGenFramebuffers(1, &accumFbo);
+      glGenTextures(1, &accumTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, accumTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, view.width, view.height, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, accumFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumTexture, 0);
+    accumWidth      = view.width;
+    accumHeight     = view.height;
+    accumView.width = 0; /* Força el reinici */
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, accumFbo);
+  if (view != accumView || key != accumKey) {
+    glClearColor(0.0, 0.0, 0.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    accumView    = view;
+    accumKey     = key;
+    accumSamples = 0;
+  }
+
+  int count = std::min(std::max(accumSamplesPerFrame, 1), ACCUM_MAX_SAMPLES - accumSamples);
+  if (count > 0) {
+    glUniform1i(iSampleOffset, accumSamples);
+    glUniform1i(iSampleCount, count);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDisable(GL_BLEND);
+    accumSamples += count;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  glUseProgram(accumProgram);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, accumTexture);
+  glUniform1i(iAccum, 0);
+  glUniform1f(iSamples, accumSamples);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 void render() {
+  if (cpuRender) {
+    renderCpu();
+    return;
+  }
+  bool accumulate = uAccumulate && uIntegration && params.INTEGRATION_MODE != INTEGRATION_PHASOR;
   glViewport(0, 0, surface->getWidth(), surface->getHeight());
   glUseProgram(program);
   glUniform1f(iTime, uTime);
   glUniform1f(iZoom, uZoom);
   glUniform2f(iResolution, surface->getWidth(), surface->getHeight());
   glUniform1i(iIntegrationMode, uIntegration);
-  glUniform1i(iDecayMode, LIGHT_DECAY_ENABLED);
-  glUniform1f(iDecayExponent, LIGHT_DECAY_EXPONENT);
+  glUniform1i(iPhasorMode, params.INTEGRATION_MODE == INTEGRATION_PHASOR);
+  glUniform1i(iDecayMode, params.LIGHT_DECAY_ENABLED);
+  glUniform1f(iDecayExponent, params.LIGHT_DECAY_EXPONENT);
   glUniform1i(iExperimentSelector, uExperiment);
   glUniform1f(iDistance, uDistance);
-  glUniform1i(iN, NCOUNT);
-  glUniform1i(iAmpladaFixa, uAmpladaFixa);
-  glUniform1i(iNormalitzarXarxa, uNormalitzarXarxa);
-  glUniform1f(iAmpladaMul, uAmpladaMul);
-  glUniform1f(iLambda, uLambda);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glUniform1i(iN, params.NCOUNT);
+  glUniform1i(iAmpladaFixa, params.uAmpladaFixa);
+  glUniform1i(iNormalitzarXarxa, params.uNormalitzarXarxa);
+  glUniform1f(iAmpladaMul, params.uAmpladaMul);
+  glUniform1f(iLambda, params.uLambda);
+  glUniform1i(iAccumulate, accumulate);
+  if (accumulate) renderAccumulated();
+  else glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// Comprovació sense pantalla, p.ex. amb xvfb-run i LIBGL_ALWAYS_SOFTWARE=1: acumula frames mostres i compara la
+// mitjana amb la mitjana temporal exacta, executarFasor() calculat a la CPU (rasterize() en mode fasorial)
+int accumulationCheck(GLuint vao, int frames) {
+  uIntegration         = true;
+  uAccumulate          = true;
+  accumSamplesPerFrame = 1;
+  glBindVertexArray(vao);
+  for (int i = 0; i < frames; i++) render();
+
+  std::vector<float> accumulated(size_t(accumWidth) * accumHeight);
+  glBindFramebuffer(GL_FRAMEBUFFER, accumFbo);
+  glReadPixels(0, 0, accumWidth, accumHeight, GL_RED, GL_FLOAT, accumulated.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  SimulationParams exact = params;
+  exact.INTEGRATION_MODE = INTEGRATION_PHASOR;
+  RasterImage reference;
+  rasterize(currentView(), exact, reference);
+
+  // glReadPixels comença per la fila de baix, la fila 0 de RasterImage és la de dalt
+  float peak = 0.0, error = 0.0;
+  for (int j = 0; j < accumHeight; j++) {
+    for (int i = 0; i < accumWidth; i++) {
+      float value = accumulated[size_t(j) * accumWidth + i] / accumSamples;
+      float ref   = reference.data[size_t(accumHeight - 1 - j) * accumWidth + i];
+      peak        = std::max(peak, std::abs(ref));
+      error       = std::max(error, std::abs(value - ref));
+    }
+  }
+  printf("accumulation: %d samples, %dx%d, max error %g, peak %g\n", accumSamples, accumWidth, accumHeight, error, peak);
+  return error > ACCUM_CHECK_TOLERANCE * peak;
 }
 
 /* MAIN CODE */
-int main() {
+int main(int argc, char** argv) {
+  int checkFrames = 0;
+  if (argc == 3 && strcmp(argv[1], "--accumulation-check") == 0) checkFrames = std::max(atoi(argv[2]), 1);
+
   SurfaceDesc desc;
-  desc.width  = 1920;
-  desc.height = 1080;
-  desc.online = true;
+  desc.width  = checkFrames ? 256 : 1920;
+  desc.height = checkFrames ? 256 : 1080;
+  desc.online = checkFrames == 0;
   surface     = NextVideo::surfaceCreate(desc);
 
   GLuint vao;
@@ -373,7 +464,9 @@ int main() {
   glBindVertexArray(vao);
 
   init();
+  if (checkFrames) return accumulationCheck(vao, checkFrames);
   ImPlot::CreateContext();
+  plotWorker = new PlotWorker();
   do {
     if (surface->getWidth() > 0 && surface->getHeight() > 0) {
       glBindVertexArray(vao);
@@ -384,4 +477,5 @@ int main() {
       surface->endUI();
     }
   } while (surface->update());
+  delete plotWorker;
 }
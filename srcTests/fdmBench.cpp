@@ -0,0 +1,615 @@
+#include <fdm.hpp>
+#include <angularSpectrum.hpp>
+#include <aperture.hpp>
+#include <experiments.hpp>
+#include <peaks.hpp>
+#include <raster.hpp>
+#include <simd.hpp>
+#include <spectrum.hpp>
+#include <workerPool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+using namespace fdm;
+
+SimulationParams simulation; /* Paràmetres que modifica cada secció */
+
+/* FDM BENCH
+ * Temps dels camins calents de la simulació. Cada secció escriu una taula per pantalla i, amb --json, cada mesura
+ * es guarda amb els seus paràmetres i estadístiques per comparar execucions (flags de compilació, commits). */
+
+// Estadístiques (ms) de repeats execucions
+struct Timing {
+  double min, median, mean, stddev;
+  int    repeats;
+};
+
+template <typename F>
+Timing measure(int repeats, F func) {
+  std::vector<double> times;
+  for (int i = 0; i < repeats; i++) {
+    auto begin = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    times.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+  }
+  std::sort(times.begin(), times.end());
+
+  Timing res = {times.front(), times[times.size() / 2], 0.0, 0.0, repeats};
+  for (double t : times) res.mean += t / repeats;
+  for (double t : times) res.stddev += (t - res.mean) * (t - res.mean) / repeats;
+  res.stddev = std::sqrt(res.stddev);
+  return res;
+}
+
+// Temps mínim (ms) de repeats execucions de func
+template <typename F>
+double bestOf(int repeats, F func) {
+  return measure(repeats, func).min;
+}
+
+typedef std::vector<std::pair<const char*, double>> BenchParams;
+
+// Mesures per --json, ja formatades
+std::vector<std::string> records;
+int                      repeatScale = 1; /* --repeats multiplica les repeticions de les seccions */
+
+std::string jsonString(const std::string& text) {
+  std::string res = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') res += '\\';
+    if (c >= 0 && c < 0x20) continue;
+    res += c;
+  }
+  return res + "\"";
+}
+
+// Guarda una mesura. evaluations és el nombre d'avaluacions d'una execució, per calcular ns/avaluació
+void record(const char* section, const char* name, const BenchParams& params, const Timing& timing, double evaluations) {
+  char        buffer[512];
+  std::string res = "{\"section\": " + jsonString(section) + ", \"name\": " + jsonString(name) + ", \"params\": {";
+  for (size_t i = 0; i < params.size(); i++) {
+    snprintf(buffer, sizeof(buffer), "%s\"%s\": %.9g", i ? ", " : "", params[i].first, params[i].second);
+    res += buffer;
+  }
+  snprintf(buffer, sizeof(buffer), "}, \"repeats\": %d, \"min_ms\": %.6g, \"median_ms\": %.6g, \"mean_ms\": %.6g, \"stddev_ms\": %.6g, \"ns_per_eval\": %.6g}",
+           timing.repeats, timing.min, timing.median, timing.mean, timing.stddev, timing.min * 1e6 / std::max(evaluations, 1.0));
+  records.push_back(res + buffer);
+}
+
+// Com measure(), però també guarda la mesura
+template <typename F>
+Timing recordMeasure(const char* section, const char* name, const BenchParams& params, double evaluations, int repeats, F func) {
+  Timing timing = measure(repeats * repeatScale, func);
+  record(section, name, params, timing, evaluations);
+  return timing;
+}
+
+volatile float sink; /* Evita que el compilador elimini els bucles de les mesures */
+
+// Funcions escalars (light, net, experimentA-D, integrate) i plot/findLocalMaximumValues variant N,
+// INTEGRATION_STEPS i plotting_count
+void benchKernels() {
+  const int          count = 2000;
+  std::vector<float> y(count);
+  for (int i = 0; i < count; i++) y[i] = (i - count / 2) * 1e-5f;
+  float x = simulation.plotting_distance;
+
+  printf("\nscalar kernels (%d points per run)\n", count);
+  printf("%-14s %6s %6s %12s %12s %10s\n", "function", "N", "steps", "ns/eval", "median ns", "stddev %");
+  auto row = [&](const char* name, int n, int steps, double evaluations, const Timing& timing) {
+    printf("%-14s %6d %6d %12.1f %12.1f %10.2f\n", name, n, steps, timing.min * 1e6 / evaluations, timing.median * 1e6 / evaluations, 100.0 * timing.stddev / timing.mean);
+  };
+
+  Timing timing = recordMeasure("kernels", "light", {}, count, 20, [&] {
+    float acc = 0.0;
+    for (int i = 0; i < count; i++) acc += light(glm::vec2(x, y[i]), 0.0, simulation);
+    sink = acc;
+  });
+  row("light", 1, 1, count, timing);
+
+  std::pair<const char*, experiment_t> experiments[] = {{"experimentA", experimentA}, {"experimentB", experimentB}, {"experimentC", experimentC}, {"experimentD", experimentD}};
+  for (int n : {2, 10, 50}) {
+    simulation.NCOUNT = n;
+    timing = recordMeasure("kernels", "net", {{"n", n}}, count, 10, [&] {
+      float acc = 0.0;
+      for (int i = 0; i < count; i++) acc += net(glm::vec2(x, y[i]), 0.0, 0.0, C_SEPARATION, simulation);
+      sink = acc;
+    });
+    row("net", n, 1, count, timing);
+
+    for (auto& experiment : experiments) {
+      timing = recordMeasure("kernels", experiment.first, {{"n", n}}, count, 10, [&] {
+        float acc = 0.0;
+        for (int i = 0; i < count; i++) acc += experiment.second(glm::vec2(x, y[i]), 0.0, simulation);
+        sink = acc;
+      });
+      row(experiment.first, n, 1, count, timing);
+    }
+  }
+
+  for (int n : {10, 50}) {
+    for (int steps : {4, 16, 64}) {
+      simulation.NCOUNT            = n;
+      simulation.INTEGRATION_STEPS = steps;
+      int points                   = count / steps;
+      timing                       = recordMeasure("kernels", "integrate", {{"n", n}, {"steps", steps}}, points, 5, [&] {
+        float acc = 0.0;
+        for (int i = 0; i < points; i++) acc += integrate(glm::vec2(x, y[i]), 0.0, experimentC, simulation);
+        sink = acc;
+      });
+      row("integrate", n, steps, points, timing);
+    }
+  }
+  simulation.INTEGRATION_STEPS = 4;
+
+  printf("\nplot / findLocalMaximumValues (experiment C)\n");
+  printf("%-24s %6s %10s %8s %12s %12s\n", "function", "N", "count", "window", "ms", "ns/point");
+  simulation.NCOUNT = 50;
+  for (int mode : {INTEGRATION_SAMPLED, INTEGRATION_PHASOR}) {
+    simulation.INTEGRATION_MODE = mode;
+    for (int points : {10000, 100000, 1000000}) {
+      simulation.plotting_count = points;
+      const char* name          = mode == INTEGRATION_PHASOR ? "plot phasor" : "plot sampled";
+      timing                    = recordMeasure("kernels", name, {{"n", simulation.NCOUNT}, {"count", points}}, points, 3, [] { plot(experimentC, simulation); });
+      printf("%-24s %6d %10d %8s %12.3f %12.1f\n", name, simulation.NCOUNT, points, "-", timing.min, timing.min * 1e6 / points);
+    }
+  }
+  simulation.INTEGRATION_MODE = INTEGRATION_SAMPLED;
+
+  for (int points : {10000, 100000, 1000000}) {
+    simulation.plotting_count = points;
+    PlotResult data           = plot(experimentC, simulation);
+    for (int window : {10, 100}) {
+      simulation.plot_highpassWindow = window;
+      timing                         = recordMeasure("kernels", "findLocalMaximumValues", {{"count", points}, {"window", window}}, points, 5, [&] { sink = findLocalMaximumValues(data.y, simulation).size(); });
+      printf("%-24s %6s %10d %8d %12.3f %12.1f\n", "findLocalMaximumValues", "-", points, window, timing.min, timing.min * 1e6 / points);
+    }
+  }
+  simulation.plot_highpassWindow = 10;
+}
+
+// Escalat de plot() amb el nombre de threads, comprovant que el resultat és idèntic al d'un sol thread
+void benchThreads() {
+  simulation.NCOUNT         = 50;
+  simulation.plotting_count = 200000;
+
+  workerPool().resize(1);
+  PlotResult reference = plot(experimentC, simulation);
+  double     base      = bestOf(3 * repeatScale, [] { plot(experimentC, simulation); });
+
+  printf("\nplot() thread scaling (experiment C, N = %d, plotting_count = %d)\n", simulation.NCOUNT, simulation.plotting_count);
+  printf("%8s %12s %10s %10s\n", "threads", "ms", "speedup", "identical");
+
+  for (int threads : {1, 2, 4, 8, 16, 24, 32, 48, 64}) {
+    workerPool().resize(threads);
+    PlotResult res;
+    double     ms        = recordMeasure("threads", "plot", {{"threads", threads}, {"count", simulation.plotting_count}}, simulation.plotting_count, 3, [&] { res = plot(experimentC, simulation); }).min;
+    bool       identical = res.y.size() == reference.y.size() && memcmp(res.y.data(), reference.y.data(), res.y.size() * sizeof(float)) == 0;
+    printf("%8d %12.3f %10.2f %10s\n", threads, ms, base / ms, identical ? "yes" : "NO");
+  }
+}
+
+// integrate() amb crida indirecta per mostra contra el kernel instanciat per experiment i flags
+void benchDispatch() {
+  simulation.NCOUNT = 50;
+  int                count = 4000;
+  std::vector<float> y(count);
+  for (int i = 0; i < count; i++) y[i] = (i - count / 2) * 1e-5f;
+  std::vector<float> pointer(count), special(count);
+
+  printf("\nexperiment dispatch (N = %d, INTEGRATION_STEPS = %d, %d points)\n", simulation.NCOUNT, simulation.INTEGRATION_STEPS, count);
+  printf("%6s %6s %14s %14s %10s %12s\n", "exp", "decay", "pointer ns/pt", "special ns/pt", "speedup", "max diff");
+
+  std::vector<ExperimentKernel> kernels = experimentRegistry();
+  for (const ExperimentKernel& kernel : kernels) {
+    for (bool decay : {false, true}) {
+      simulation.LIGHT_DECAY_ENABLED = decay;
+      double pointerMs               = recordMeasure("dispatch", "pointer", {{"experiment", &kernel - kernels.data()}, {"decay", decay}}, count, 3, [&] {
+        for (int i = 0; i < count; i++) pointer[i] = integrate(glm::vec2(simulation.plotting_distance, y[i]), 0.0, kernel.func, simulation);
+      }).min;
+      double specialMs               = recordMeasure("dispatch", "special", {{"experiment", &kernel - kernels.data()}, {"decay", decay}}, count, 3, [&] {
+        kernel.integrate[kernelMode(simulation)](simulation.plotting_distance, y.data(), count, 0.0, simulation, special.data());
+      }).min;
+
+      float diff = 0.0;
+      for (int i = 0; i < count; i++) diff = std::max(diff, std::abs(pointer[i] - special[i]));
+      printf("%6s %6d %14.1f %14.1f %10.2f %12g\n", kernel.name, decay, pointerMs * 1e6 / count, specialMs * 1e6 / count, pointerMs / specialMs, diff);
+    }
+  }
+  simulation.LIGHT_DECAY_ENABLED = false;
+}
+
+// Camp llunyà d'una obertura mostrejada: FFT contra la suma directa de M mostres per punt
+void benchAperture() {
+  simulation.plotting_count    = 4000;
+  simulation.plotting_distance = 1.0;
+  PlotResult         grid      = plotAperture(apertureSlits(1, 1e-6, 0.0, 1e-6), simulation);
+  std::vector<float> fast(grid.x.size()), direct(grid.x.size());
+
+  printf("\naperture far field (%d points, distance %g m)\n", simulation.plotting_count, simulation.plotting_distance);
+  printf("%10s %12s %12s %10s %12s\n", "samples", "fft ms", "direct ms", "speedup", "max rel diff");
+
+  for (int slits : {10, 100, 1000}) {
+    // Escletxes de 2 um cada 10 um, mostrejades a 0.1 um
+    Aperture aperture = apertureSlits(slits, 2e-6, 1e-5, 1e-7);
+    BenchParams params   = {{"samples", aperture.transmission.size()}, {"count", simulation.plotting_count}};
+    double      fftMs    = recordMeasure("aperture", "fft", params, grid.x.size(), 3, [&] {
+      apertureFarField(aperture, simulation.plotting_distance, grid.x.data(), grid.x.size(), simulation, fast.data());
+    }).min;
+    double      directMs = recordMeasure("aperture", "direct", params, grid.x.size(), 1, [&] {
+      apertureFarFieldDirect(aperture, simulation.plotting_distance, grid.x.data(), grid.x.size(), simulation, direct.data());
+    }).min;
+
+    float peak = 0.0, diff = 0.0;
+    for (size_t i = 0; i < grid.x.size(); i++) {
+      peak = std::max(peak, direct[i]);
+      diff = std::max(diff, std::abs(fast[i] - direct[i]));
+    }
+    printf("%10zu %12.3f %12.3f %10.2f %12g\n", aperture.transmission.size(), fftMs, directMs, directMs / fftMs, diff / peak);
+  }
+}
+
+// Espectre angular 2D: primer frame (plans i H), frames següents i escalat amb threads. Una fila es compara amb
+// la suma directa de Rayleigh-Sommerfeld (la resposta impulsional que discretitza la FFT) per dues taques
+// gaussianes, que a diferència dels focus puntuals no surten de la finestra
+void benchSpectrum() {
+  int     size   = 512;
+  double  z      = 20e-6;
+  double  lambda = simulation.uLambda;
+  Field2D field;
+  field.width  = size;
+  field.height = size;
+  field.data.resize(size_t(size) * size);
+
+  double dx = field.dx, w0 = 1e-6;
+  for (int j = 0; j < size; j++)
+    for (int i = 0; i < size; i++) {
+      double px = (i - size / 2) * dx, py = (j - size / 2) * dx;
+      double a  = std::exp(-(px * px + (py - 2e-6) * (py - 2e-6)) / (w0 * w0));
+      double b  = std::exp(-(px * px + (py + 2e-6) * (py + 2e-6)) / (w0 * w0));
+      field.data[size_t(j) * size + i] = a + b;
+    }
+
+  std::vector<float> intensity;
+  workerPool().resize(0);
+  AngularSpectrum spectrum;
+  double          firstMs = recordMeasure("spectrum", "first frame", {{"size", size}}, double(size) * size, 1, [&] { spectrum.propagate(field, lambda, z, intensity); }).min;
+
+  double                 k   = 2.0 * M_PI / lambda;
+  int                    row = size / 2 + 37;
+  std::vector<complex_t> direct(size, 0.0);
+  for (int j = 0; j < size; j++)
+    for (int i = 0; i < size; i++) {
+      complex_t t = field.data[size_t(j) * size + i];
+      if (std::abs(t) < 1e-12) continue;
+      for (int x = 0; x < size; x++) {
+        double px = (x - i) * dx, py = (row - j) * dx;
+        double r  = std::sqrt(px * px + py * py + z * z);
+        direct[x] += t * dx * dx * z / (2.0 * M_PI * r * r) * complex_t(1.0 / r, -k) * std::polar(1.0, k * r);
+      }
+    }
+  float peak = 0.0, diff = 0.0;
+  for (int x = 0; x < size; x++) peak = std::max(peak, float(0.5 * std::norm(direct[x])));
+  for (int x = 0; x < size; x++) diff = std::max(diff, std::abs(intensity[size_t(row) * size + x] - float(0.5 * std::norm(direct[x]))));
+
+  printf("\nangular spectrum %dx%d (z = %g m), first frame %.3f ms, max rel diff %g\n", size, size, z, firstMs, diff / peak);
+  printf("%8s %12s %10s\n", "threads", "ms/frame", "speedup");
+  double base = 0.0;
+  for (int threads : {1, 2, 4, 8, 16}) {
+    workerPool().resize(threads);
+    double ms = recordMeasure("spectrum", "frame", {{"size", size}, {"threads", threads}}, double(size) * size, 5, [&] {
+      spectrum.propagate(field, lambda, z, intensity);
+    }).min;
+    if (threads == 1) base = ms;
+    printf("%8d %12.3f %10.2f\n", threads, ms, base / ms);
+  }
+  workerPool().resize(0);
+}
+
+// Implementació anterior de findLocalMaximumValues(), O(n window)
+std::vector<int> findLocalMaximumValuesScan(std::vector<float>& data, int lookUpSize) {
+  std::vector<int> indices;
+  if (int(data.size()) < lookUpSize * 2 + 1) return {};
+
+  for (int i = lookUpSize; i < int(data.size()) - lookUpSize - 1; i++) {
+    bool isMaxima = true;
+    for (int j = i - lookUpSize; j < i + lookUpSize; j++) {
+      if (data[j] > data[i]) {
+        isMaxima = false;
+        break;
+      }
+    }
+    if (isMaxima) indices.push_back(i);
+  }
+  return indices;
+}
+
+// Cerca de màxims amb la finestra original contra PeakDetector, sobre un plot real
+void benchPeaks() {
+  simulation.NCOUNT         = 50;
+  simulation.plotting_count = 1000000;
+  PlotResult data           = plot(experimentC, simulation);
+
+  printf("\npeak detection (%d samples)\n", simulation.plotting_count);
+  printf("%8s %12s %12s %10s %10s\n", "window", "scan ms", "deque ms", "speedup", "identical");
+
+  for (int window : {10, 100, 1000, 10000}) {
+    std::vector<int> scan, deque;
+    double           scanMs  = recordMeasure("peaks", "scan", {{"window", window}}, data.y.size(), 1, [&] { scan = findLocalMaximumValuesScan(data.y, window); }).min;
+    double           dequeMs = recordMeasure("peaks", "deque", {{"window", window}}, data.y.size(), 3, [&] {
+      deque.clear();
+      PeakDetector detector(window);
+      detector.push(data.y.data(), data.y.size(), deque);
+    }).min;
+    printf("%8d %12.3f %12.3f %10.2f %10s\n", window, scanMs, dequeMs, scanMs / dequeMs, scan == deque ? "yes" : "NO");
+  }
+}
+
+// Mostreig adaptatiu contra la graella uniforme: punts avaluats, temps i error de la interpolació lineal del
+// resultat adaptatiu, a tot el plot i als màxims locals de la graella uniforme
+void benchAdaptive() {
+  simulation.NCOUNT            = 50;
+  simulation.plotting_count    = 200000;
+  simulation.plotting_adaptive = 0.0;
+  PlotResult uniform           = plot(experimentC, simulation);
+  double     uniformMs = recordMeasure("adaptive", "uniform", {{"count", simulation.plotting_count}}, simulation.plotting_count, 3, [] { plot(experimentC, simulation); }).min;
+  std::vector<int> peaks = findLocalMaximumValues(uniform.y, simulation);
+
+  float peak = 0.0;
+  for (float v : uniform.y) peak = std::max(peak, v);
+
+  printf("\nadaptive sampling (experiment C, N = %d, %d uniform points, %.3f ms)\n", simulation.NCOUNT, simulation.plotting_count, uniformMs);
+  printf("%10s %10s %10s %10s %12s %12s\n", "tolerance", "points", "fraction", "speedup", "max err", "peak err");
+
+  for (float tolerance : {1e-2f, 1e-3f, 1e-4f}) {
+    simulation.plotting_adaptive = tolerance;
+    PlotResult adaptive;
+    double     ms     = recordMeasure("adaptive", "adaptive", {{"tolerance", tolerance}, {"count", simulation.plotting_count}}, simulation.plotting_count, 3, [&] {
+      adaptive = plot(experimentC, simulation);
+    }).min;
+
+    // Interpolació lineal del resultat adaptatiu a cada punt de la graella uniforme
+    std::vector<float> interpolated(uniform.x.size());
+    for (size_t i = 0, j = 0; i < uniform.x.size(); i++) {
+      while (j + 2 < adaptive.x.size() && adaptive.x[j + 1] <= uniform.x[i]) j++;
+      float f         = (uniform.x[i] - adaptive.x[j]) / (adaptive.x[j + 1] - adaptive.x[j]);
+      interpolated[i] = adaptive.y[j] + (adaptive.y[j + 1] - adaptive.y[j]) * std::min(std::max(f, 0.0f), 1.0f);
+    }
+    float err = 0.0, peakErr = 0.0;
+    for (size_t i = 0; i < uniform.x.size(); i++) err = std::max(err, std::abs(interpolated[i] - uniform.y[i]));
+    for (int i : peaks) peakErr = std::max(peakErr, std::abs(interpolated[i] - uniform.y[i]));
+
+    printf("%10g %10zu %10.3f %10.2f %12g %12g\n", tolerance, adaptive.x.size(), float(adaptive.x.size()) / uniform.x.size(), uniformMs / ms, err / peak, peakErr / peak);
+  }
+  simulation.plotting_adaptive = 0.0;
+}
+
+// integrateBatch() i integratePhasorBatch() per cada KERNEL_PRECISION, amb la diferència màxima respecte
+// PRECISION_FULL relativa al màxim
+void benchPrecision() {
+  const int          count = 20000;
+  std::vector<float> y(count), full(count), out(count);
+  for (int i = 0; i < count; i++) y[i] = (i - count / 2) * 1e-6f;
+  float x = simulation.plotting_distance;
+
+  printf("\nkernel precision (experiment C, %d points per run)\n", count);
+  printf("%-22s %8s %6s %12s %10s %12s\n", "function", "level", "N", "ns/point", "speedup", "max diff");
+  for (int n : {10, 50}) {
+    simulation.NCOUNT                     = n;
+    std::vector<ExperimentSource> sources = experimentSources(experimentC, simulation);
+    for (int mode : {INTEGRATION_SAMPLED, INTEGRATION_PHASOR}) {
+      const char* name = mode == INTEGRATION_PHASOR ? "integratePhasorBatch" : "integrateBatch";
+      auto        run  = [&](float* res) {
+        if (mode == INTEGRATION_PHASOR) integratePhasorBatch(x, y.data(), count, sources, simulation, res);
+        else integrateBatch(x, y.data(), count, 0.0, sources, simulation, res);
+      };
+      double base = 0.0;
+      for (int precision : {PRECISION_FULL, PRECISION_MEDIUM, PRECISION_LOW}) {
+        simulation.KERNEL_PRECISION = precision;
+        run(precision == PRECISION_FULL ? full.data() : out.data());
+        Timing timing = recordMeasure("precision", name, {{"n", n}, {"precision", precision}}, count, 10, [&] { run(out.data()); });
+        if (precision == PRECISION_FULL) base = timing.min;
+
+        float peak = *std::max_element(full.begin(), full.end()), diff = 0.0;
+        for (int i = 0; i < count; i++) diff = std::max(diff, std::abs(out[i] - full[i]));
+        printf("%-22s %8s %6d %12.2f %10.2f %12.3g\n", name, kernelPrecisionName(precision), n, timing.min * 1e6 / count, base / timing.min, diff / peak);
+      }
+    }
+  }
+  simulation.KERNEL_PRECISION = PRECISION_FULL;
+}
+
+// rasterize() de la imatge de fdm.glsl per cada mode del shader, amb tots els threads del pool
+void benchRaster() {
+  RasterView view;
+  view.width      = 640;
+  view.height     = 360;
+  view.experiment = 2;
+  int         pixels = view.width * view.height;
+  RasterImage image;
+
+  printf("\nraster (experiment C, %dx%d, %d threads)\n", view.width, view.height, workerPool().size());
+  printf("%-10s %6s %12s %12s\n", "mode", "N", "ms/frame", "ns/pixel");
+  for (int n : {10, 50}) {
+    simulation.NCOUNT = n;
+    for (int mode = 0; mode < 3; mode++) {
+      const char* name            = mode == 0 ? "instant" : mode == 1 ? "sampled" : "phasor";
+      view.integration            = mode > 0;
+      simulation.INTEGRATION_MODE = mode == 2 ? INTEGRATION_PHASOR : INTEGRATION_SAMPLED;
+
+      Timing timing = recordMeasure("raster", name, {{"n", n}, {"width", view.width}, {"height", view.height}}, pixels, 3, [&] { rasterize(view, simulation, image); });
+      printf("%-10s %6d %12.2f %12.2f\n", name, n, timing.min, timing.min * 1e6 / pixels);
+    }
+  }
+  simulation.INTEGRATION_MODE = INTEGRATION_SAMPLED;
+
+  // Temps fins a la primera imatge sencera de ProgressiveRaster (la passada de 1/16 dels píxels), lot a lot
+  view.integration = true;
+  Timing timing    = recordMeasure("raster", "progressive", {{"n", simulation.NCOUNT}, {"width", view.width}, {"height", view.height}}, pixels, 3, [&] {
+    ProgressiveRaster progressive;
+    progressive.request(view, simulation);
+    while (progressive.stride() == PROGRESSIVE_COARSE) progressive.step(0.0);
+  });
+  printf("%-10s %6d %12.2f %12.2f (first pass)\n", "progressive", simulation.NCOUNT, timing.min, timing.min * 1e6 / pixels);
+}
+
+// plot() mentre canvia lambda (com arrossegant el slider), amb i sense taula de geometria. La primera iteració
+// construeix la taula i la resta només recalculen la trigonometria
+void benchGeometry() {
+  SimulationParams p = simulation;
+  p.plotting_fresnel = 0.0;
+
+  printf("\ngeometry (experiment D, %d points, lambda changes every plot)\n", p.plotting_count);
+  printf("%-10s %-8s %6s %12s %12s\n", "mode", "table", "N", "ms/plot", "speedup");
+  for (int mode : {INTEGRATION_SAMPLED, INTEGRATION_PHASOR}) {
+    p.INTEGRATION_MODE = mode;
+    for (int n : {10, 50}) {
+      p.NCOUNT         = n;
+      double baseline  = 0.0;
+      for (int mb : {0, 64}) {
+        p.plotting_geometry_mb = mb;
+        int    step            = 0;
+        Timing timing          = recordMeasure("geometry", mb ? "table" : "direct", {{"n", n}, {"mode", mode}}, p.plotting_count, 20, [&] {
+          p.uLambda = 4e-7 + (step++ % 40) * 1e-8;
+          plot(experimentD, p);
+        });
+        if (mb == 0) baseline = timing.median;
+        printf("%-10s %-8s %6d %12.3f %11.2fx\n", mode == INTEGRATION_PHASOR ? "phasor" : "sampled", mb ? "yes" : "no", n, timing.median, baseline / timing.median);
+      }
+    }
+  }
+}
+
+// spectralPlot() contra repetir el plot fasorial a cada longitud d'ona de la taula i sumar-lo amb els pesos
+void benchSpectral() {
+  SpectralTable table  = spectralTable(blackbodySpectrum(6500), 64);
+  int           points = simulation.plotting_count;
+
+  printf("\nspectral (experiment C, %d points, %d wavelengths, %d threads)\n", points, table.samples, workerPool().size());
+  printf("%-10s %6s %12s %12s\n", "path", "N", "ms", "ns/point");
+  for (int n : {10, 50}) {
+    simulation.NCOUNT = n;
+    Timing shared     = recordMeasure("spectral", "shared", {{"n", n}, {"samples", table.samples}}, points, 3, [&] { spectralPlot(experimentC, table, simulation); });
+    printf("%-10s %6d %12.2f %12.2f\n", "shared", n, shared.min, shared.min * 1e6 / points);
+
+    SimulationParams p = simulation;
+    p.INTEGRATION_MODE = INTEGRATION_PHASOR;
+    p.plotting_fresnel = 0.0;
+    std::vector<float> rgb(size_t(points) * 3);
+    Timing             naive = recordMeasure("spectral", "per-lambda", {{"n", n}, {"samples", table.samples}}, points, 3, [&] {
+      std::fill(rgb.begin(), rgb.end(), 0.0f);
+      for (int m = 0; m < table.samples; m++) {
+        p.uLambda         = 2.0 * M_PI / (table.k0 + m * table.dk);
+        PlotResult result = plot(experimentC, p);
+        for (int i = 0; i < points; i++)
+          for (int c = 0; c < 3; c++) rgb[3 * i + c] += table.weight[c][m] * result.y[i];
+      }
+    });
+    printf("%-10s %6d %12.2f %12.2f\n", "per-lambda", n, naive.min, naive.min * 1e6 / points);
+  }
+}
+
+// plot() fasorial d'una xarxa de 1000 línies per mm amb la suma directa i amb l'avaluació jeràrquica, amb la
+// pantalla cada 1 µm al voltant de l'ordre 0. error és la diferència màxima relativa al màxim de la suma directa
+void benchTree() {
+  SimulationParams p    = simulation;
+  p.INTEGRATION_MODE    = INTEGRATION_PHASOR;
+  p.plotting_fresnel    = 0.0;
+  p.plotting_resolution = 6;
+  p.uAmpladaMul         = 1e-6;
+
+  printf("\ntree (experiment C, %d points every 1 um, %d threads)\n", p.plotting_count, workerPool().size());
+  printf("%-12s %8s %12s %12s %12s\n", "path", "N", "ms/plot", "speedup", "error");
+  for (int n : {10000, 100000, 1000000}) {
+    p.NCOUNT            = n;
+    p.plotting_tree     = 0;
+    PlotResult direct   = plot(experimentC, p);
+    Timing     baseline = recordMeasure("tree", "direct", {{"n", n}}, double(p.plotting_count) * n, n > 100000 ? 1 : 3, [&] { plot(experimentC, p); });
+    printf("%-12s %8d %12.2f\n", "direct", n, baseline.min);
+
+    p.plotting_tree   = 1;
+    PlotResult tree   = plot(experimentC, p);
+    Timing     timing = recordMeasure("tree", "hierarchical", {{"n", n}}, double(p.plotting_count) * n, 3, [&] { plot(experimentC, p); });
+    float      peak = 0.0, error = 0.0;
+    for (size_t i = 0; i < direct.y.size(); i++) {
+      peak  = std::max(peak, direct.y[i]);
+      error = std::max(error, std::abs(tree.y[i] - direct.y[i]));
+    }
+    printf("%-12s %8d %12.2f %11.2fx %12.2g\n", plotPathName(tree.path), n, timing.min, baseline.min / timing.min, error / peak);
+  }
+}
+
+static std::pair<const char*, void (*)()> sections[] = {
+  {"kernels", benchKernels}, {"threads", benchThreads}, {"dispatch", benchDispatch}, {"aperture", benchAperture},
+  {"spectrum", benchSpectrum}, {"peaks", benchPeaks}, {"adaptive", benchAdaptive}, {"precision", benchPrecision},
+  {"raster", benchRaster}, {"spectral", benchSpectral}, {"geometry", benchGeometry}, {"tree", benchTree},
+};
+
+static void usage() {
+  printf("Usage: fdm_bench [--section NAME ...] [--repeats N] [--json FILE] [--label TEXT]\n\n");
+  printf("Sections:");
+  for (auto& section : sections) printf(" %s", section.first);
+  printf("\nWithout --section every section runs. --repeats multiplies the repetitions of each measure.\n");
+  printf("--json writes every measure (parameters, min/median/mean/stddev ms and ns per evaluation) with the build\n");
+  printf("configuration, so runs can be compared across compiler flags and commits. --label is stored with it.\n");
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> selected;
+  std::string              json, label;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      usage();
+      return 0;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Expected '--option value', got '%s'\n", argv[i]);
+      return 1;
+    }
+    const char* value = argv[++i];
+    if (strcmp(argv[i - 1], "--section") == 0) selected.push_back(value);
+    else if (strcmp(argv[i - 1], "--repeats") == 0) repeatScale = std::max(1, atoi(value));
+    else if (strcmp(argv[i - 1], "--json") == 0) json = value;
+    else if (strcmp(argv[i - 1], "--label") == 0) label = value;
+    else {
+      fprintf(stderr, "Unknown option '%s'\n", argv[i - 1]);
+      return 1;
+    }
+  }
+  for (const std::string& name : selected) {
+    if (std::none_of(std::begin(sections), std::end(sections), [&](auto& section) { return name == section.first; })) {
+      fprintf(stderr, "Unknown section '%s'\n", name.c_str());
+      return 1;
+    }
+  }
+
+  printf("fdm_bench: simd %s (%d lanes), %u hardware threads\n", simd::backendName, simd::vfloat::width, std::thread::hardware_concurrency());
+  for (auto& section : sections)
+    if (selected.empty() || std::find(selected.begin(), selected.end(), section.first) != selected.end()) section.second();
+
+  if (!json.empty()) {
+    FILE* file = fopen(json.c_str(), "w");
+    if (!file) {
+      fprintf(stderr, "Can't open output file %s\n", json.c_str());
+      return 1;
+    }
+#ifdef __OPTIMIZE__
+    bool optimized = true;
+#else
+    bool optimized = false;
+#endif
+    fprintf(file, "{\n  \"label\": %s,\n  \"compiler\": %s,\n", jsonString(label).c_str(), jsonString(__VERSION__).c_str());
+    fprintf(file, "  \"optimized\": %s,\n", optimized ? "true" : "false");
+    fprintf(file, "  \"simd\": \"%s\",\n  \"lanes\": %d,\n  \"hardware_threads\": %u,\n", simd::backendName, simd::vfloat::width, std::thread::hardware_concurrency());
+    fprintf(file, "  \"results\": [\n");
+    for (size_t i = 0; i < records.size(); i++) fprintf(file, "    %s%s\n", records[i].c_str(), i + 1 < records.size() ? "," : "");
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+  }
+}
@@ -0,0 +1,432 @@
+#include <fdm.hpp>
+#include <accuracy.hpp>
+#include <animation.hpp>
+#include <aperture.hpp>
+#include <raster.hpp>
+#include <spectrum.hpp>
+#include <sweep.hpp>
+#include <workerPool.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+using namespace fdm;
+
+/* FDM SENSE FINESTRA
+ * Calcula el plot i els seus màxims amb els mateixos paràmetres que la interfície de fdm, llegits de la línia de
+ * comandes o d'un fitxer de configuració, i escriu el resultat en CSV o binari. No depèn de GL ni de GLFW.
+ * Amb --sweep s'avalua un producte cartesià de paràmetres i cada perfil s'escriu a mesura que s'acaba.
+ * Amb --aperture el plot és el camp llunyà d'una obertura arbitrària (aperture.hpp) en lloc d'un experiment.
+ * Amb --check es comproven els camins optimitzats contra la referència en long double (accuracy.hpp).
+ * Amb --render s'escriu en PNG la imatge 2D de fdm.glsl calculada a la CPU (raster.hpp), i amb --animate una
+ * seqüència de frames en vídeo sense comprimir (animation.hpp).
+ * Amb --spectrum el plot i la imatge de --render són en RGB, integrats sobre l'espectre de la font (spectrum.hpp). */
+
+SimulationParams       params;
+int                    experiment = 0;
+int                    format     = 0; /* 0 = csv, 1 = binari */
+int                    threads    = 0;
+std::string            output;
+std::vector<SweepAxis> sweepAxes;
+std::string            apertureSpec;
+float                  apertureDx    = 1e-7;
+float                  apertureSigma = 0.0;
+std::string            renderPath;
+RasterView             view;
+float                  exposure = 1.0;
+std::string            animatePath;
+int                    frames      = 100;
+float                  timeStep    = 0.01;
+int                    fps         = 30;
+int                    videoFormat = 0; /* 0 = y4m, 1 = float */
+std::string            spectrumSpec;
+int                    spectralSamples = 64;
+
+enum OptionType { OPTION_INT, OPTION_FLOAT, OPTION_BOOL, OPTION_ENUM };
+
+struct Option {
+  const char* name;
+  OptionType  type;
+  void*       value;
+  const char* help;
+  const char* values = nullptr; /* Noms separats per '|' per OPTION_ENUM */
+};
+
+static Option options[] = {
+  {"experiment", OPTION_ENUM, &experiment, "Experiment del laboratori", "A|B|C|D"},
+  {"n", OPTION_INT, &params.NCOUNT, "Nombre de focus de la xarxa"},
+  {"steps", OPTION_INT, &params.INTEGRATION_STEPS, "Pasos de integració"},
+  {"mode", OPTION_ENUM, &params.INTEGRATION_MODE, "Mode d'integració", "sampled|phasor"},
+  {"lambda", OPTION_FLOAT, &params.uLambda, "Longitud d'ona (m)"},
+  {"amplada", OPTION_FLOAT, &params.uAmpladaMul, "Separació de la xarxa de l'experiment C (m)"},
+  {"amplada-fixa", OPTION_BOOL, &params.uAmpladaFixa, "Amplada de la xarxa fixa"},
+  {"normalitzar", OPTION_BOOL, &params.uNormalitzarXarxa, "Normalitzar la xarxa per N"},
+  {"decay", OPTION_BOOL, &params.LIGHT_DECAY_ENABLED, "Activar divisió per distància"},
+  {"decay-exponent", OPTION_FLOAT, &params.LIGHT_DECAY_EXPONENT, "Exponent de la correcció de distància"},
+  {"phase-reference", OPTION_BOOL, &params.PHASE_REFERENCE, "Fase relativa al centre de la xarxa"},
+  {"precision", OPTION_ENUM, &params.KERNEL_PRECISION, "Precisió del sin dels kernels vectorials", "full|medium|low"},
+  {"distance", OPTION_FLOAT, &params.plotting_distance, "Distància de la pantalla (m)"},
+  {"resolution", OPTION_FLOAT, &params.plotting_resolution, "Resolució del plot (pas 10^-resolution)"},
+  {"count", OPTION_INT, &params.plotting_count, "Punts del plot"},
+  {"window", OPTION_INT, &params.plot_highpassWindow, "Finestra de cerca de màxims"},
+  {"threads", OPTION_INT, &threads, "Threads, 0 = tots"},
+  {"adaptive", OPTION_FLOAT, &params.plotting_adaptive, "Tolerància del mostreig adaptatiu, 0 = uniforme"},
+  {"geometry-mb", OPTION_INT, &params.plotting_geometry_mb, "Memòria màxima de la taula de distàncies del plot (MB), 0 = sense taula"},
+  {"fresnel", OPTION_FLOAT, &params.plotting_fresnel, "Fresnel màxim pel camp llunyà (mode phasor), 0 = mai"},
+  {"tree", OPTION_INT, &params.plotting_tree, "Focus a partir dels quals el mode phasor és jeràrquic, 0 = mai"},
+  {"tree-error", OPTION_FLOAT, &params.plotting_tree_error, "Error relatiu màxim de l'avaluació jeràrquica"},
+  {"aperture-dx", OPTION_FLOAT, &apertureDx, "Separació de mostres de l'obertura (m)"},
+  {"aperture-apodise", OPTION_FLOAT, &apertureSigma, "Sigma de l'apodització gaussiana (m), 0 = cap"},
+  {"format", OPTION_ENUM, &format, "Format de sortida", "csv|bin"},
+  {"width", OPTION_INT, &view.width, "Amplada de la imatge de --render"},
+  {"height", OPTION_INT, &view.height, "Alçada de la imatge de --render"},
+  {"zoom", OPTION_FLOAT, &view.zoom, "Zoom de la imatge (iZoom)"},
+  {"time", OPTION_FLOAT, &view.time, "Temps de la imatge (iTime)"},
+  {"screen", OPTION_FLOAT, &view.distance, "Distància dels focus a la imatge (iDistance, m)"},
+  {"integration", OPTION_BOOL, &view.integration, "Imatge integrada en el temps (iIntegrationMode)"},
+  {"render-steps", OPTION_INT, &view.steps, "Pasos de integració de la imatge (4 al shader)"},
+  {"exposure", OPTION_FLOAT, &exposure, "Multiplicador del valor abans de passar-lo a 8 bits"},
+  {"frames", OPTION_INT, &frames, "Frames de --animate"},
+  {"time-step", OPTION_FLOAT, &timeStep, "Increment de iTime entre frames de --animate"},
+  {"fps", OPTION_INT, &fps, "Frames per segon del vídeo y4m"},
+  {"video-format", OPTION_ENUM, &videoFormat, "Format de --animate", "y4m|raw"},
+  {"spectral-samples", OPTION_INT, &spectralSamples, "Longituds d'ona de --spectrum"},
+};
+
+static Option* findOption(const char* name) {
+  for (Option& option : options)
+    if (strcmp(option.name, name) == 0) return &option;
+  return nullptr;
+}
+
+// Índex de value dins de la llista "a|b|c", o el valor numèric si és un número
+static int parseEnum(const char* values, const char* value) {
+  char* end;
+  long  number = strtol(value, &end, 10);
+  if (*value && *end == 0) return number;
+
+  int         index = 0;
+  const char* name  = values;
+  while (*name) {
+    int length = strcspn(name, "|");
+    if (int(strlen(value)) == length && strncasecmp(name, value, length) == 0) return index;
+    name += length;
+    if (*name == '|') name++;
+    index++;
+  }
+  return -1;
+}
+
+static bool setOption(const char* name, const char* value) {
+  Option* option = findOption(name);
+  if (!option) {
+    fprintf(stderr, "Unknown option '%s'\n", name);
+    return false;
+  }
+
+  char* end = nullptr;
+  switch (option->type) {
+    case OPTION_INT: *(int*)option->value = strtol(value, &end, 10); break;
+    case OPTION_FLOAT: *(float*)option->value = strtof(value, &end); break;
+    case OPTION_BOOL: *(bool*)option->value = strcmp(value, "0") != 0 && strcasecmp(value, "false") != 0; return true;
+    case OPTION_ENUM: {
+      int index = parseEnum(option->values, value);
+      if (index < 0) {
+        fprintf(stderr, "Invalid value '%s' for '%s' (%s)\n", value, name, option->values);
+        return false;
+      }
+      *(int*)option->value = index;
+      return true;
+    }
+  }
+
+  if (end == value || *end != 0) {
+    fprintf(stderr, "Invalid value '%s' for '%s'\n", value, name);
+    return false;
+  }
+  return true;
+}
+
+// Fitxer de configuració amb línies "clau = valor", les línies que comencen per '#' s'ignoren
+static bool loadConfig(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Can't open config file %s\n", path);
+    return false;
+  }
+
+  char line[512];
+  int  lineNumber = 0;
+  bool ok         = true;
+  while (ok && fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    char key[128], value[256];
+    if (line[strspn(line, " \t\r\n")] == '#' || line[strspn(line, " \t\r\n")] == 0) continue;
+    if (sscanf(line, " %127[^= \t] = %255s", key, value) != 2) {
+      fprintf(stderr, "%s:%d: expected 'key = value'\n", path, lineNumber);
+      ok = false;
+    } else {
+      ok = setOption(key, value);
+    }
+  }
+  fclose(file);
+  return ok;
+}
+
+static void usage() {
+  printf("Usage: fdm_cli [--config FILE] [--output FILE] [--sweep SPEC ...] [--aperture SPEC] [--render FILE] [--animate FILE] [--spectrum SPEC] [--<option> VALUE ...]\n\n");
+  for (Option& option : options) {
+    printf("  --%-16s %s", option.name, option.help);
+    if (option.type == OPTION_ENUM) printf(" (%s)", option.values);
+    if (option.type == OPTION_BOOL) printf(" (0|1)");
+    printf("\n");
+  }
+  printf("\nThe config file uses the same option names as 'key = value' lines.\n");
+  printf("--sweep name=start:end:count or name=v1,v2,... adds a sweep axis over lambda, n, distance, amplada,\n");
+  printf("steps, decay-exponent or resolution. Every profile of the cartesian product is written in order.\n");
+  printf("--aperture slits:count:width:spacing, random:cells:cell:fill:seed or FILE (one transmission per line)\n");
+  printf("plots the FFT far field of a sampled aperture instead of the experiment.\n");
+  printf("--check all or PATH,PATH,... compares the optimised paths against the long double reference on the\n");
+  printf("canonical configurations, prints the worst point of each and exits with 1 if any error budget fails.\n");
+  printf("--render FILE writes the fdm.glsl image of the experiment as a greyscale PNG, computed on the CPU with\n");
+  printf("the width, height, zoom, time, screen, integration and mode options instead of the plot.\n");
+  printf("--animate FILE (or - for stdout) writes frames images of the same view starting at time and advancing\n");
+  printf("time-step per frame, as greyscale y4m or raw float32 frames ('FDMA' header). Rendering and writing overlap.\n");
+  printf("--spectrum blackbody:K, led:nm:fwhm_nm or FILE ('nm power' lines) integrates the time averaged intensity\n");
+  printf("over the source spectrum and writes x,r,g,b rows (or an RGB PNG with --render).\n");
+}
+
+// Imatge de fdm.glsl amb els mateixos uniforms que la interfície, en RGB si hi ha espectre
+static int render(const Spectrum* spectrum) {
+  view.experiment = experiment;
+  RasterImage image;
+  if (spectrum) rasterizeSpectral(view, params, spectralTable(*spectrum, spectralSamples), image);
+  else rasterize(view, params, image);
+  if (!writePng(renderPath.c_str(), image, exposure)) {
+    fprintf(stderr, "Can't write image %s\n", renderPath.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// Animació de la mateixa imatge que render(). Els frames es calculen mentre el thread d'escriptura escriu l'anterior
+static int animate() {
+  view.experiment = experiment;
+  FILE* file      = animatePath == "-" ? stdout : fopen(animatePath.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "Can't open output file %s\n", animatePath.c_str());
+    return 1;
+  }
+
+  if (videoFormat == 0) writeY4mHeader(file, view.width, view.height, fps);
+  else writeRawHeader(file, view.width, view.height, frames);
+  runAnimation(view, params, frames, timeStep, [&](const AnimationFrame& frame) {
+    if (videoFormat == 0) writeY4mFrame(file, frame.image, exposure);
+    else writeRawFrame(file, frame);
+    if (file != stdout) fprintf(stderr, "\rframe %d/%d", frame.index + 1, frames);
+  });
+  if (file != stdout) fprintf(stderr, "\n");
+
+  bool failed = ferror(file);
+  if (file != stdout) failed |= fclose(file) != 0;
+  else failed |= fflush(file) != 0;
+  if (failed) {
+    fprintf(stderr, "Can't write animation %s\n", animatePath.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+// CSV: una fila per punt, maximum = 1 pels màxims locals i 2 pels màxims dels màxims.
+// En un sweep cada fila porta davant l'índex del perfil i el valor de cada eix
+static void writeCsvHeader(FILE* file) {
+  if (!sweepAxes.empty()) {
+    fprintf(file, "index,");
+    for (const SweepAxis& axis : sweepAxes) fprintf(file, "%s,", axis.name.c_str());
+  }
+  fprintf(file, "x,y,maximum\n");
+}
+
+static void writeCsv(FILE* file, const PlotAnalysis& analysis, const SweepPoint* point = nullptr) {
+  std::vector<int> level(analysis.data.x.size(), 0);
+  for (int i : analysis.maximum) level[i] = 1;
+  for (int i : analysis.maximum2) level[analysis.maximum[i]] = 2;
+
+  std::string prefix;
+  if (point) {
+    prefix = std::to_string(point->index) + ",";
+    char value[32];
+    for (float v : point->values) {
+      snprintf(value, sizeof(value), "%.9g,", v);
+      prefix += value;
+    }
+  }
+
+  for (size_t i = 0; i < analysis.data.x.size(); i++)
+    fprintf(file, "%s%.9g,%.9g,%d\n", prefix.c_str(), analysis.data.x[i], analysis.data.y[i], level[i]);
+}
+
+// Binari: "FDMP", versió i un registre. Cada registre és: punts, màxims, màxims dels màxims (int32) i després
+// x[], y[] (float32), maximum[] i maximum2[] (int32, índexs a x/y i a maximum respectivament)
+static void writeBinaryRecord(FILE* file, const PlotAnalysis& analysis) {
+  int header[] = {int(analysis.data.x.size()), int(analysis.maximum.size()), int(analysis.maximum2.size())};
+  fwrite(header, sizeof(int), 3, file);
+  fwrite(analysis.data.x.data(), sizeof(float), analysis.data.x.size(), file);
+  fwrite(analysis.data.y.data(), sizeof(float), analysis.data.y.size(), file);
+  fwrite(analysis.maximum.data(), sizeof(int), analysis.maximum.size(), file);
+  fwrite(analysis.maximum2.data(), sizeof(int), analysis.maximum2.size(), file);
+}
+
+// Sweep binari: "FDMS", versió, nombre d'eixos i per cada eix nom (char[32]), nombre de valors (int32) i valors
+// (float32). Després, per cada perfil, índex (int32), valor de cada eix (float32) i un registre
+static void writeSweepHeader(FILE* file) {
+  int header[] = {1, int(sweepAxes.size())};
+  fwrite("FDMS", 1, 4, file);
+  fwrite(header, sizeof(int), 2, file);
+  for (const SweepAxis& axis : sweepAxes) {
+    char name[32] = {};
+    strncpy(name, axis.name.c_str(), sizeof(name) - 1);
+    int count = axis.values.size();
+    fwrite(name, 1, sizeof(name), file);
+    fwrite(&count, sizeof(int), 1, file);
+    fwrite(axis.values.data(), sizeof(float), count, file);
+  }
+}
+
+static void writeSweepPoint(FILE* file, const SweepPoint& point) {
+  fwrite(&point.index, sizeof(int), 1, file);
+  fwrite(point.values.data(), sizeof(float), point.values.size(), file);
+  writeBinaryRecord(file, point.analysis);
+}
+
+// Plot espectral: CSV amb x,r,g,b o binari "FDMC", versió, punts (int32) i després x[] i rgb[] (float32, 3 per punt)
+static void writeSpectral(FILE* file, const SpectralPlot& plot) {
+  if (format == 1) {
+    int header[] = {1, int(plot.x.size())};
+    fwrite("FDMC", 1, 4, file);
+    fwrite(header, sizeof(int), 2, file);
+    fwrite(plot.x.data(), sizeof(float), plot.x.size(), file);
+    fwrite(plot.rgb.data(), sizeof(float), plot.rgb.size(), file);
+    return;
+  }
+  fprintf(file, "x,r,g,b\n");
+  for (size_t i = 0; i < plot.x.size(); i++) fprintf(file, "%.9g,%.9g,%.9g,%.9g\n", plot.x[i], plot.rgb[3 * i], plot.rgb[3 * i + 1], plot.rgb[3 * i + 2]);
+}
+
+// Una línia per comprovació amb l'error, el pressupost i el pitjor punt
+static int check(const char* paths) {
+  std::vector<AccuracyCheck> checks = runAccuracyChecks(paths);
+  int                        failed = 0;
+  for (const AccuracyCheck& check : checks) {
+    printf("%-4s %-18s %-72s error %-11.3g budget %-8.3g worst y = %-11.5g value %-12.6g reference %.6g\n", check.pass() ? "ok" : "FAIL", check.path.c_str(),
+           check.config.c_str(), check.error, check.budget, check.y, check.value, check.reference);
+    failed += !check.pass();
+  }
+  printf("%d checks, %d failed\n", int(checks.size()), failed);
+  return failed > 0 || checks.empty();
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+      usage();
+      return 0;
+    }
+    if (strncmp(argv[i], "--", 2) != 0 || i + 1 >= argc) {
+      fprintf(stderr, "Expected '--option value', got '%s'\n", argv[i]);
+      return 1;
+    }
+
+    const char* name  = argv[i] + 2;
+    const char* value = argv[++i];
+    if (strcmp(name, "config") == 0) {
+      if (!loadConfig(value)) return 1;
+    } else if (strcmp(name, "output") == 0) {
+      output = value;
+    } else if (strcmp(name, "sweep") == 0) {
+      SweepAxis axis;
+      if (!sweepAxisParse(value, axis)) {
+        fprintf(stderr, "Invalid sweep axis '%s'\n", value);
+        return 1;
+      }
+      sweepAxes.push_back(axis);
+    } else if (strcmp(name, "aperture") == 0) {
+      apertureSpec = value;
+    } else if (strcmp(name, "render") == 0) {
+      renderPath = value;
+    } else if (strcmp(name, "spectrum") == 0) {
+      spectrumSpec = value;
+    } else if (strcmp(name, "animate") == 0) {
+      animatePath = value;
+    } else if (strcmp(name, "check") == 0) {
+      return check(value);
+    } else if (!setOption(name, value)) {
+      return 1;
+    }
+  }
+
+  workerPool().resize(threads);
+  Spectrum spectrum;
+  if (!spectrumSpec.empty()) {
+    if (!spectrumParse(spectrumSpec.c_str(), spectrum)) {
+      fprintf(stderr, "Invalid spectrum '%s'\n", spectrumSpec.c_str());
+      return 1;
+    }
+    if (!sweepAxes.empty() || !apertureSpec.empty() || !animatePath.empty()) {
+      fprintf(stderr, "--spectrum can't be combined with --sweep, --aperture or --animate\n");
+      return 1;
+    }
+  }
+
+  if (!renderPath.empty()) return render(spectrumSpec.empty() ? nullptr : &spectrum);
+  if (!animatePath.empty()) return animate();
+
+  Aperture aperture;
+  if (!apertureSpec.empty()) {
+    if (!sweepAxes.empty()) {
+      fprintf(stderr, "--aperture can't be combined with --sweep\n");
+      return 1;
+    }
+    if (!apertureParse(apertureSpec.c_str(), apertureDx, aperture)) {
+      fprintf(stderr, "Invalid aperture '%s'\n", apertureSpec.c_str());
+      return 1;
+    }
+    if (apertureSigma > 0.0) apertureApodise(aperture, apertureSigma);
+  }
+
+  FILE* file = output.empty() || output == "-" ? stdout : fopen(output.c_str(), format == 1 ? "wb" : "w");
+  if (!file) {
+    fprintf(stderr, "Can't open output file %s\n", output.c_str());
+    return 1;
+  }
+
+  if (!spectrumSpec.empty()) {
+    writeSpectral(file, spectralPlot(experimentSelect(experiment), spectralTable(spectrum, spectralSamples), params));
+  } else if (!sweepAxes.empty()) {
+    if (format == 1) writeSweepHeader(file);
+    else writeCsvHeader(file);
+
+    runSweep(experimentSelect(experiment), params, sweepAxes, [&](const SweepPoint& point) {
+      if (format == 1) writeSweepPoint(file, point);
+      else writeCsv(file, point.analysis, &point);
+    });
+  } else {
+    PlotAnalysis        apertureAnalysis;
+    if (!apertureSpec.empty()) apertureAnalysis = analyzePlot(plotAperture(aperture, params), params);
+    const PlotAnalysis& analysis = apertureSpec.empty() ? cachedPlotAnalysis(experimentSelect(experiment), params) : apertureAnalysis;
+    fprintf(stderr, "Plot path: %s (Fresnel %g)\n", plotPathName(analysis.data.path), analysis.data.fresnel);
+    if (params.INTEGRATION_MODE == INTEGRATION_PHASOR && analysis.data.mode != INTEGRATION_PHASOR) fprintf(stderr, "Warning: the experiment has no phasor variant, the plot is the sampled mean\n");
+    if (format == 1) {
+      int version = 1;
+      fwrite("FDMP", 1, 4, file);
+      fwrite(&version, sizeof(int), 1, file);
+      writeBinaryRecord(file, analysis);
+    } else {
+      writeCsvHeader(file);
+      writeCsv(file, analysis);
+    }
+  }
+
+  if (file != stdout) fclose(file);
+  return 0;
+}